@@ -0,0 +1,417 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <maytag/maytag.h>
+
+
+struct scene_t
+{
+	uint32_t w;
+	uint32_t h;
+	std::vector<uint8_t> d;
+	std::vector<uint16_t> id; // Rendered tag ids.
+};
+
+// Draw a rotated and scaled tag (4x4 supersampling).
+void draw_tag(scene_t& scene, const maytag::tag_family_t& tf, uint16_t id, double cx, double cy, double scale, double angle)
+{
+	const uint32_t tw = tf.total_width;
+	const uint32_t wb = tf.width_at_border;
+	const uint32_t offset = (tw - wb) / 2;
+	const uint8_t val_b = tf.black ? 0 : 255;
+	const uint8_t val_w = tf.black ? 255 : 0;
+	std::vector<uint8_t> tag(tw * tw, val_w);
+	for (uint32_t i = 0; i < wb; ++i)
+	{
+		tag[offset * tw + offset + i] = val_b;
+		tag[(offset + wb - 1) * tw + offset + i] = val_b;
+		tag[(offset + i) * tw + offset] = val_b;
+		tag[(offset + i) * tw + offset + wb - 1] = val_b;
+	}
+	const uint64_t code = tf.codes[id];
+	for (uint32_t b = 0; b < tf.nbits; ++b)
+	{
+		const uint32_t idx = (offset + tf.bit_y[b]) * tw + offset + tf.bit_x[b];
+		tag[idx] = ((code >> (tf.nbits - b - 1)) & 1) ? val_w : val_b;
+	}
+	const double ca = std::cos(angle);
+	const double sa = std::sin(angle);
+	const int r = static_cast<int>(scale * tw) + 2;
+	for (int y = static_cast<int>(cy) - r; y <= static_cast<int>(cy) + r; ++y)
+	{
+		for (int x = static_cast<int>(cx) - r; x <= static_cast<int>(cx) + r; ++x)
+		{
+			if (x < 0 || y < 0 || x >= static_cast<int>(scene.w) || y >= static_cast<int>(scene.h))
+				continue;
+			const uint32_t p = y * scene.w + x;
+			int acc = 0;
+			for (int sy = 0; sy < 4; ++sy)
+			{
+				for (int sx = 0; sx < 4; ++sx)
+				{
+					const double px = x + (sx + 0.5) / 4 - cx;
+					const double py = y + (sy + 0.5) / 4 - cy;
+					const double u = (ca * px + sa * py) / scale + 0.5 * tw;
+					const double v = (-sa * px + ca * py) / scale + 0.5 * tw;
+					if (u < 0 || v < 0 || u >= tw || v >= tw)
+						acc += scene.d[p];
+					else
+						acc += tag[static_cast<uint32_t>(v) * tw + static_cast<uint32_t>(u)];
+				}
+			}
+			scene.d[p] = acc / 16;
+		}
+	}
+	scene.id.emplace_back(id);
+}
+
+// Grid of tags on a cluttered background with noise.
+scene_t make_scene(const maytag::tag_family_t& tf, uint32_t w, uint32_t h, uint32_t ntags, uint32_t seed)
+{
+	scene_t scene;
+	scene.w = w;
+	scene.h = h;
+	scene.d.assign(w * h, 128);
+	std::mt19937 rng(seed);
+	// Clutter: boxes and windows.
+	for (uint32_t k = 0; k < 500; ++k)
+	{
+		const uint32_t x0 = rng() % w;
+		const uint32_t y0 = rng() % h;
+		const uint32_t s = 10 + rng() % 60;
+		const uint8_t c = rng() % 256;
+		const bool window = (k & 1);
+		for (uint32_t y = y0; y < std::min(h, y0 + s); ++y)
+		{
+			for (uint32_t x = x0; x < std::min(w, x0 + s); ++x)
+			{
+				const bool frame = (x - x0 < s / 8 || y - y0 < s / 8 || x0 + s - x <= s / 8 || y0 + s - y <= s / 8);
+				scene.d[y * w + x] = (window && !frame) ? 255 - c : c;
+			}
+		}
+	}
+	// Tags.
+	const uint32_t nx = static_cast<uint32_t>(std::ceil(std::sqrt(ntags * static_cast<double>(w) / h)));
+	const uint32_t ny = (ntags + nx - 1) / nx;
+	const double cell = std::min(static_cast<double>(w) / nx, static_cast<double>(h) / ny);
+	const double scale = 0.6 * cell / tf.total_width;
+	for (uint32_t i = 0; i < ntags; ++i)
+	{
+		const double cx = (i % nx + 0.5) * cell;
+		const double cy = (i / nx + 0.5) * cell;
+		const double s = scale * (0.8 + 0.2 * (rng() % 100) / 100.0);
+		const double a = 0.5 * (rng() % 100) / 100.0;
+		draw_tag(scene, tf, (i * 7) % tf.ncodes, cx, cy, s, a);
+	}
+	// Noise.
+	for (auto& v : scene.d)
+	{
+		const int n = static_cast<int>(v) + static_cast<int>(rng() % 11) - 5;
+		v = static_cast<uint8_t>(std::min(255, std::max(0, n)));
+	}
+	return scene;
+}
+
+template <typename T>
+double run(maytag::BasicDetector<T>& detector, const maytag::image_t& img, uint32_t iters, std::vector<maytag::tag_t>& tags)
+{
+	tags = detector.calc(img);
+	auto beg = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iters; ++i)
+		detector.calc(img);
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg).count() * 1e-6 / iters;
+}
+
+// Throughput of the pipelined detector (time per frame).
+// Time per frame of the two pipeline halves run in one thread (front: calc_labels, back: calc_quads and calc_tags).
+template <typename T>
+void run_halves(maytag::BasicDetector<T>& detector, const maytag::image_t& img, uint32_t iters, double& front, double& back)
+{
+	auto contours = detector.make_contours();
+	std::chrono::nanoseconds front_ns(0);
+	std::chrono::nanoseconds back_ns(0);
+	for (uint32_t i = 0; i < iters; ++i)
+	{
+		auto beg = std::chrono::steady_clock::now();
+		const maytag::image_t thresh_img = detector.calc_labels(img, *contours);
+		auto mid = std::chrono::steady_clock::now();
+		detector.calc_tags(detector.calc_quads(img, thresh_img, *contours), img);
+		auto end = std::chrono::steady_clock::now();
+		front_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(mid - beg);
+		back_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - mid);
+	}
+	front = front_ns.count() * 1e-6 / iters;
+	back = back_ns.count() * 1e-6 / iters;
+}
+
+template <typename T>
+double run_pipeline(maytag::BasicPipeline<T>& pipeline, const maytag::image_t& img, uint32_t iters)
+{
+	std::vector<maytag::tag_t> tags;
+	auto beg = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iters; ++i)
+	{
+		if (pipeline.pending() == pipeline.slots())
+			pipeline.pop(tags);
+		pipeline.push(img);
+	}
+	while (pipeline.pop(tags))
+		;
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg).count() * 1e-6 / iters;
+}
+
+template <typename T>
+void setup(maytag::BasicDetector<T>& detector, const maytag::tag_family_t& tf, double decimate, uint32_t threads, maytag::dict_type_t dict_type)
+{
+	detector.set_quad_decimate(decimate);
+	detector.set_decode_threads(threads);
+	detector.set_dict_type(dict_type);
+	detector.add_family(tf);
+}
+
+// Compare with the double precision results (the tag order is the same).
+// Returns false if the results are out of the tolerance of fixed.h (the same ids, corners < 0.02 px on average and < 0.5 px at most).
+bool compare(const std::string& name, const std::vector<maytag::tag_t>& tags_ref, const std::vector<maytag::tag_t>& tags, double dt_ref, double dt)
+{
+	uint32_t id_diff = 0;
+	double corner_max = 0.0;
+	double corner_sum = 0.0;
+	const size_t size = std::min(tags_ref.size(), tags.size());
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (tags_ref[i].id != tags[i].id)
+		{
+			++id_diff;
+			continue;
+		}
+		for (int j = 0; j < 4; ++j)
+		{
+			const double dx = tags_ref[i].p[j].x - tags[i].p[j].x;
+			const double dy = tags_ref[i].p[j].y - tags[i].p[j].y;
+			const double d = std::sqrt(dx * dx + dy * dy);
+			corner_sum += d;
+			if (d > corner_max)
+				corner_max = d;
+		}
+	}
+	id_diff += std::max(tags_ref.size(), tags.size()) - size;
+	const double corner_mean = corner_sum / (4 * std::max<size_t>(size, 1));
+	const bool ok = id_diff == 0 && corner_mean < 0.02 && corner_max < 0.5;
+	std::cout << name << " vs double:" << std::endl;
+	std::cout << "\tspeedup: " << dt_ref / dt << std::endl;
+	std::cout << "\tid differences: " << id_diff << std::endl;
+	std::cout << "\tcorner difference: mean " << corner_mean << " px, max " << corner_max << " px" << std::endl;
+	std::cout << "\ttolerance: " << (ok ? "ok" : "failed") << std::endl;
+	return ok;
+}
+
+// The masked detector must give the same threshold image and tags for the same frame in a row
+// (the threshold image is cleared only when the mask changes, the inactive tiles must stay unknown).
+bool check_mask_repeat(const maytag::tag_family_t& tf, const maytag::image_t& img)
+{
+	maytag::Detector detector;
+	detector.add_family(tf);
+	detector.set_roi({maytag::roi_t(0, 0, img.w / 3, img.h / 4)});
+	auto contours = detector.make_contours();
+	std::vector<uint8_t> thresh_ref;
+	std::vector<maytag::tag_t> tags_ref;
+	for (int k = 0; k < 3; ++k)
+	{
+		const maytag::image_t thresh_img = detector.calc_labels(img, *contours);
+		const std::vector<uint8_t> thresh(thresh_img.d, thresh_img.d + static_cast<size_t>(thresh_img.w) * thresh_img.h);
+		const std::vector<maytag::tag_t> tags = detector.calc_tags(detector.calc_quads(img, thresh_img, *contours), img);
+		if (k == 0)
+		{
+			thresh_ref = thresh;
+			tags_ref = tags;
+			continue;
+		}
+		size_t pixels = 0;
+		for (size_t i = 0; i < thresh.size(); ++i)
+			pixels += thresh[i] != thresh_ref[i];
+		bool same = pixels == 0 && tags.size() == tags_ref.size();
+		for (size_t i = 0; same && i < tags.size(); ++i)
+		{
+			same = tags[i].id == tags_ref[i].id;
+			for (int j = 0; same && j < 4; ++j)
+				same = tags[i].p[j].x == tags_ref[i].p[j].x && tags[i].p[j].y == tags_ref[i].p[j].y;
+		}
+		if (!same)
+		{
+			std::cout << "mask check: frame " << k << " differs from frame 0 (" << pixels << " threshold pixels, "
+				<< tags.size() << " vs " << tags_ref.size() << " tags)" << std::endl;
+			return false;
+		}
+	}
+	std::cout << "mask check: ok" << std::endl;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string family = "tag36h11";
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t ntags = 100;
+	uint32_t hamming = 1;
+	uint32_t iters = 20;
+	uint32_t threads = 1;
+	double decimate = 1.0;
+	std::string dict = "auto";
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const size_t eq = arg.find('=');
+		if (arg == "-h" || eq == std::string::npos)
+		{
+			std::cout << "Usage: maytag-benchmark [-f=tag36h11] [-iw=1920] [-ih=1080] [-n=100] [-ha=1] [-i=20] [-t=1] [-x=1] [-d=auto]" << std::endl;
+			return 0;
+		}
+		const std::string key = arg.substr(0, eq);
+		const std::string val = arg.substr(eq + 1);
+		if (key == "-f")
+			family = val;
+		else if (key == "-iw")
+			width = std::stoul(val);
+		else if (key == "-ih")
+			height = std::stoul(val);
+		else if (key == "-n")
+			ntags = std::stoul(val);
+		else if (key == "-ha")
+			hamming = std::stoul(val);
+		else if (key == "-i")
+			iters = std::stoul(val);
+		else if (key == "-t")
+			threads = std::stoul(val);
+		else if (key == "-x")
+			decimate = std::stod(val);
+		else if (key == "-d")
+			dict = val;
+	}
+
+	maytag::tag_family_t tf;
+	if (family == "tag16h5")
+		tf = maytag::tag16h5(true, hamming);
+	else if (family == "tag25h9")
+		tf = maytag::tag25h9(true, hamming);
+	else if (family == "tag36h10")
+		tf = maytag::tag36h10(true, hamming);
+	else if (family == "tag36h11")
+		tf = maytag::tag36h11(true, hamming);
+	else
+	{
+		std::cout << "Unrecognized tag family name (" << family << ")." << std::endl;
+		return -1;
+	}
+
+	maytag::dict_type_t dict_type;
+	if (dict == "auto")
+		dict_type = maytag::dict_type_t::automatic;
+	else if (dict == "hash")
+		dict_type = maytag::dict_type_t::hash;
+	else if (dict == "mih")
+		dict_type = maytag::dict_type_t::mih;
+	else if (dict == "brute")
+		dict_type = maytag::dict_type_t::brute;
+	else if (dict == "canonical")
+		dict_type = maytag::dict_type_t::canonical;
+	else
+	{
+		std::cout << "Unrecognized dictionary type (" << dict << ")." << std::endl;
+		return -1;
+	}
+
+	scene_t scene = make_scene(tf, width, height, ntags, 1);
+	maytag::image_t img(scene.w, scene.h, scene.d.data());
+
+	maytag::Detector detector;
+	setup(detector, tf, decimate, threads, dict_type);
+	maytag::DetectorF detector_f;
+	setup(detector_f, tf, decimate, threads, dict_type);
+	maytag::DetectorFixed detector_q;
+	setup(detector_q, tf, decimate, threads, dict_type);
+
+	std::vector<maytag::tag_t> tags;
+	std::vector<maytag::tag_t> tags_f;
+	std::vector<maytag::tag_t> tags_q;
+	const double dt = run(detector, img, iters, tags);
+	const double dt_f = run(detector_f, img, iters, tags_f);
+	const double dt_q = run(detector_q, img, iters, tags_q);
+	maytag::Pipeline pipeline;
+	setup(pipeline.detector(), tf, decimate, threads, dict_type);
+#if defined(MAYTAG_TRACE)
+	maytag::trace_start();
+#endif
+	const double dt_p = run_pipeline(pipeline, img, iters);
+#if defined(MAYTAG_TRACE)
+	maytag::trace_stop();
+#endif
+	maytag::Detector detector_h;
+	setup(detector_h, tf, decimate, threads, dict_type);
+	double dt_front = 0.0;
+	double dt_back = 0.0;
+	run_halves(detector_h, img, iters, dt_front, dt_back);
+
+	std::cout << "scene: " << family << " " << width << "x" << height << ", " << ntags << " tags" << std::endl;
+	std::cout << "double: " << dt << " ms, " << tags.size() << " tags" << std::endl;
+	std::cout << "float:  " << dt_f << " ms, " << tags_f.size() << " tags" << std::endl;
+	std::cout << "fixed:  " << dt_q << " ms, " << tags_q.size() << " tags" << std::endl;
+	std::cout << "pipeline (double): " << dt_p << " ms per frame, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+	std::cout << "pipeline halves: front " << dt_front << " ms, back " << dt_back << " ms (the slower one bounds the frame time with two free cores)" << std::endl;
+	const maytag::memory_t m = detector.memory_peak();
+	std::cout << "double memory: " << m.stages() / 1024 << " KB stages, " << m.dict / 1024 << " KB dictionaries" << std::endl;
+#if defined(MAYTAG_TIMING)
+	const maytag::timing_t& t = detector.timing();
+	std::cout << "double stages (last frame):" << std::endl;
+	std::cout << "\tdecimate: " << t.decimate << " ms" << std::endl;
+	std::cout << "\tthreshold: " << t.threshold << " ms" << std::endl;
+	std::cout << "\tcontour label: " << t.contour_label << " ms" << std::endl;
+	std::cout << "\tcontour collect: " << t.contour_collect << " ms" << std::endl;
+	std::cout << "\tquad sort: " << t.quad_sort << " ms" << std::endl;
+	std::cout << "\tquad fit: " << t.quad_fit << " ms" << std::endl;
+	std::cout << "\tquad refine: " << t.quad_refine << " ms" << std::endl;
+	std::cout << "\tdecode: " << t.decode << " ms (dictionary " << t.dict << " ms)" << std::endl;
+	const maytag::histogram_t& l = detector.latency().total;
+	std::cout << "double latency (" << l.count() << " frames): p50 " << l.percentile(50.0) << " ms, p90 " << l.percentile(90.0)
+		<< " ms, p99 " << l.percentile(99.0) << " ms, max " << l.max() << " ms" << std::endl;
+	const maytag::histogram_t& lp = pipeline.latency();
+	std::cout << "pipeline latency (push to pop): p50 " << lp.percentile(50.0) << " ms, p99 " << lp.percentile(99.0) << " ms" << std::endl;
+#endif
+#if defined(MAYTAG_PERF)
+	if (maytag::Detector::perf_available())
+	{
+		const maytag::perf_stat_t& p = detector.perf();
+		const std::pair<const char*, const maytag::perf_t*> stages[] = {
+			{"decimate", &p.decimate}, {"threshold", &p.threshold},
+			{"contour label", &p.contour_label}, {"contour collect", &p.contour_collect},
+			{"quad sort", &p.quad_sort}, {"quad fit", &p.quad_fit}, {"quad refine", &p.quad_refine},
+			{"decode", &p.decode}};
+		std::cout << "double stages counters (last frame): cycles, instructions, cache misses, branch misses" << std::endl;
+		for (const auto& stage : stages)
+			std::cout << "\t" << stage.first << ": " << stage.second->cycles << ", " << stage.second->instructions
+				<< ", " << stage.second->cache_misses << ", " << stage.second->branch_misses << std::endl;
+	}
+	else
+		std::cout << "perf_event_open is not available (see /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+#endif
+#if defined(MAYTAG_TRACE)
+	if (maytag::trace_save("maytag-trace.json"))
+		std::cout << "pipeline trace: maytag-trace.json" << std::endl;
+#endif
+	const bool ok_f = compare("float", tags, tags_f, dt, dt_f);
+	const bool ok_q = compare("fixed", tags, tags_q, dt, dt_q);
+	if (!ok_f || !ok_q)
+		return 1;
+	if (!check_mask_repeat(tf, img))
+		return 1;
+	return 0;
+}
@@ -42,7 +42,8 @@ int main(int argc, char* argv[])
 		"{b black    | 1       | tag color: 1 - black, 0 - white}"
 		"{ha hamming | 1       | number of error correction bits (hamming distance)}"
 		"{x decimate | 1.0     | decimate input image by this factor (supported 1, 1.5, 2, 3, ...)}"
-		"{r refine   | 1       | spend more time trying to align edges of tags: 1 - on, 0 - off}";
+		"{r refine   | 1       | spend more time trying to align edges of tags: 1 - on, 0 - off}"
+		"{t threads  | 1       | number of decode threads}";
 
 	cv::CommandLineParser parser(argc, argv, keys);
 
@@ -72,10 +73,12 @@ int main(int argc, char* argv[])
 	const int hamming = parser.get<int>("hamming");
 	const double decimate = parser.get<float>("decimate");
 	const bool refine = parser.get<bool>("refine");
+	const int threads = parser.get<int>("threads");
 
 	maytag::Detector detector;
 	detector.set_quad_decimate(decimate);
 	detector.set_refine_edges(refine);
+	detector.set_decode_threads(threads);
 	detector.set_dict_stat(true);
 	if (family == "tag16h5")
 		detector.add_family(maytag::tag16h5(black, hamming));
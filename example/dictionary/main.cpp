@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <maytag/maytag.h>
+
+
+// Write the hash dictionary table as a header.
+bool write_header(const maytag::dict_table_t& t, const std::string& func, const std::string& path)
+{
+	FILE* f = std::fopen(path.c_str(), "w");
+	if (!f)
+		return false;
+	std::fprintf(f, "#pragma once\n\n#include <cstdint>\n\n#include \"dict_table.h\"\n\n\n");
+	std::fprintf(f, "namespace maytag\n{\n");
+	std::fprintf(f, "\t// Generated by example/dictionary (%s, hamming %u).\n", t.name.c_str(), static_cast<uint32_t>(t.hamming));
+	std::fprintf(f, "\tdict_table_t %s()\n\t{\n", func.c_str());
+	std::fprintf(f, "\t\talignas(64) static const uint64_t table[%u] =\n\t\t{\n", t.size);
+	for (uint32_t i = 0; i < t.size; i += 4)
+	{
+		std::fprintf(f, "\t\t\t");
+		for (uint32_t k = i; k < i + 4 && k < t.size; ++k)
+			std::fprintf(f, "0x%016llxULL,%s", static_cast<unsigned long long>(t.table[k]), k + 1 < i + 4 ? " " : "");
+		std::fprintf(f, "\n");
+	}
+	std::fprintf(f, "\t\t};\n\n");
+	std::fprintf(f, "\t\tdict_table_t t;\n");
+	std::fprintf(f, "\t\tt.name = \"%s\";\n", t.name.c_str());
+	std::fprintf(f, "\t\tt.version = %u;\n", t.version);
+	std::fprintf(f, "\t\tt.ncodes = %u;\n", t.ncodes);
+	std::fprintf(f, "\t\tt.nbits = %u;\n", t.nbits);
+	std::fprintf(f, "\t\tt.hamming = %u;\n", static_cast<uint32_t>(t.hamming));
+	std::fprintf(f, "\t\tt.size = %u;\n", t.size);
+	std::fprintf(f, "\t\tt.max_search = %u;\n", t.max_search);
+	std::fprintf(f, "\t\tt.canonical = %s;\n", t.canonical ? "true" : "false");
+	std::fprintf(f, "\t\tt.table = table;\n");
+	std::fprintf(f, "\t\treturn t;\n\t}\n}\n");
+	return std::fclose(f) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string family = "tag36h11";
+	uint32_t hamming = 1;
+	double size_scale = 3.0;
+	bool canonical = true;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const size_t eq = arg.find('=');
+		if (arg == "-h" || eq == std::string::npos)
+		{
+			std::cout << "Usage: maytag-dictionary [-f=tag36h11] [-ha=1] [-s=3] [-c=1]" << std::endl;
+			return 0;
+		}
+		const std::string key = arg.substr(0, eq);
+		const std::string val = arg.substr(eq + 1);
+		if (key == "-f")
+			family = val;
+		else if (key == "-ha")
+			hamming = std::stoul(val);
+		else if (key == "-s")
+			size_scale = std::stod(val);
+		else if (key == "-c")
+			canonical = std::stoul(val) != 0;
+	}
+
+	maytag::tag_family_t tf;
+	if (family == "tag16h5")
+		tf = maytag::tag16h5(true, hamming);
+	else if (family == "tag25h9")
+		tf = maytag::tag25h9(true, hamming);
+	else if (family == "tag36h10")
+		tf = maytag::tag36h10(true, hamming);
+	else if (family == "tag36h11")
+		tf = maytag::tag36h11(true, hamming);
+	else
+	{
+		std::cout << "Unrecognized tag family name (" << family << ")." << std::endl;
+		return -1;
+	}
+	if (!maytag::_::DictionaryHash::supported(tf))
+	{
+		std::cout << "The family is not supported by the hash dictionary." << std::endl;
+		return -1;
+	}
+
+	const maytag::_::DictionaryHash dict(tf, size_scale, true, canonical);
+	const maytag::dict_table_t t = dict.table(tf.name);
+	const std::string func = tf.name + "_h" + std::to_string(t.hamming) + "_table";
+	const std::string path = func + ".h";
+	if (!write_header(t, func, path))
+	{
+		std::cout << "Failed to write " << path << "." << std::endl;
+		return -1;
+	}
+	std::cout << "Saved: " << path << std::endl;
+	return 0;
+}
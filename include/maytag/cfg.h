@@ -2,7 +2,9 @@
 
 #include <cstdint>
 #include <memory>
+#include <vector>
 
+#include "image.h"
 #include "pt.h"
 #include "tag_family.h"
 #include "dictionary.h"
@@ -36,6 +38,24 @@ namespace maytag::_
 		double decode_sharpening = 0.25;
 		double min_score = 20.0;
 		bool interpolate = true;
+		// Reject quads with a low contrast across the border before decoding.
+		bool prefilter = true;
+		double prefilter_min_diff = 10.0;
+		// Number of threads for the decode stage.
+		// A thread is started only for every decode_min_quads quads.
+		uint32_t decode_threads = 1;
+		uint32_t decode_min_quads = 16;
+		// Soft decision (Chase) decoding: all combinations of the chase_bits least reliable bits are flipped.
+		// The dictionaries are built with chase_dict_hamming (the rest is corrected by the flips).
+		uint8_t chase_bits = 0;
+		uint8_t chase_dict_hamming = 1;
+		// Active area: the union of the rectangles and the nonzero cells of the mask (mask_w x mask_h cells over the input image).
+		// Empty - the whole image. mask_version is changed with them.
+		std::vector<roi_t> roi;
+		std::vector<uint8_t> mask;
+		uint32_t mask_w = 0;
+		uint32_t mask_h = 0;
+		uint32_t mask_version = 0;
 
 		uint8_t border_mask = 0;
 		uint32_t max_total_width = 0;
@@ -5,6 +5,8 @@
 
 #include "cfg.h"
 #include "image.h"
+#include "mask.h"
+#include "timing.h"
 
 
 namespace maytag::_
@@ -24,6 +26,14 @@ namespace maytag::_
 		}
 	};
 
+	// Contour counters of the last frame.
+	struct contour_stat_t
+	{
+		uint32_t components = 0; // Connected components (without the ones touching low contrast or unknown pixels).
+		uint32_t small = 0;      // Components smaller than min_contour_size.
+		uint32_t contours = 0;   // Output contours.
+	};
+
 	class Contours
 	{
 	private:
@@ -46,6 +56,11 @@ namespace maytag::_
 		std::vector<uint32_t> _u;
 		std::vector<rn_t> _rn;
 		std::vector<std::vector<cpt_t>> _contours;
+		contour_stat_t _stat;
+		double _time_label = 0.0;
+		double _time_collect = 0.0;
+		perf_t _perf_label;
+		perf_t _perf_collect;
 
 		inline uint32_t _get_root(uint32_t id) const
 		{
@@ -123,263 +138,405 @@ namespace maytag::_
 			while (root != root_ref);
 		}
 
+		// The window with the bottom right pixel p (inside the image).
+		inline void _label(uint32_t p, uint32_t w, uint8_t mask)
+		{
+			switch (mask)
+			{
+				// |0 0|
+				// |0 1| => 0000'0001 = 1
+				case 1:
+				// |1 1|
+				// |1 0| => 0101'0100 = 84
+				case 84:
+					_new(p);
+					break;
+				// |0 0|
+				// |1 0| => 0001'0000 = 16
+				case 16:
+				// |0 0|
+				// |1 1| => 0001'0001 = 17
+				case 17:
+				// |1 1|
+				// |0 0| => 0100'0100 = 68
+				case 68:
+				// |1 1|
+				// |0 1| => 0100'0101 = 69
+				case 69:
+					_new_connect(p, p - 1);
+					break;
+				// |0 1|
+				// |0 0| => 0000'0100 = 4
+				case 4:
+				// |0 1|
+				// |0 1| => 0000'0101 = 5
+				case 5:
+				// |1 0|
+				// |1 0| => 0101'0000 = 80
+				case 80:
+				// |1 0|
+				// |1 1| => 0101'0001 = 81
+				case 81:
+					_new_connect(p, p - w);
+					break;
+				// |0 1|
+				// |1 0| => 0001'0100 = 20
+				case 20:
+				// |0 1|
+				// |1 1| => 0001'0101 = 21
+				case 21:
+				// |1 0|
+				// |0 0| => 0100'0000 = 64
+				case 64:
+				// |1 0|
+				// |0 1| => 0100'0001 = 65
+				case 65:
+					_new_connect(p, p - 1, p - w);
+					break;
+				// |0 1|
+				// |1 -| => 0001'0110 = 22
+				case 22:
+				// |1 0|
+				// |0 -| => 0100'0010 = 66
+				case 66:
+					_zero_connect(p - 1);
+					_zero_connect(p - w);
+					break;
+				// |0 0|
+				// |1 -| => 0001'0010 = 18
+				case 18:
+				// |0 -|
+				// |1 -| => 0001'1010 = 26
+				case 26:
+				// |1 1|
+				// |0 -| => 0100'0110 = 70
+				case 70:
+				// |1 -|
+				// |0 -| => 0100'1010 = 74
+				case 74:
+					_zero_connect(p - 1);
+					break;
+				// |0 1|
+				// |0 -| => 0000'0110 = 6
+				case 6:
+				// |0 1|
+				// |- 0| => 0010'0100 = 36
+				case 36:
+				// |0 1|
+				// |- 1| => 0010'0101 = 37
+				case 37:
+				// |0 1|
+				// |- -| => 0010'0110 = 38
+				case 38:
+				// |1 0|
+				// |1 -| => 0101'0010 = 82
+				case 82:
+				// |1 0|
+				// |- 0| => 0110'0000 = 96
+				case 96:
+				// |1 0|
+				// |- 1| => 0110'0001 = 97
+				case 97:
+				// |1 0|
+				// |- -| => 0110'0010 = 98
+				case 98:
+					_zero_connect(p - w);
+					break;
+			}
+		}
+
+		// The window on the right border.
+		// We do not check for low contrast.
+		inline void _label_right(uint32_t p, uint32_t w, uint8_t mask)
+		{
+			switch (mask)
+			{
+				// |0 0|
+				// |1 0| => 0001'0000 = 16
+				case 16:
+				// |1 1|
+				// |0 1| => 0100'0101 = 69
+				case 69:
+					_new_connect(p, p - 1);
+					break;
+				// |0 1|
+				// |0 1| => 0000'0101 = 5
+				case 5:
+				// |1 0|
+				// |1 0| => 0101'0000 = 80
+				case 80:
+					_new_connect(p, p - w);
+					break;
+				// |0 1|
+				// |1 1| => 0001'0101 = 21
+				case 21:
+				// |1 0|
+				// |0 0| => 0100'0000 = 64
+				case 64:
+					_new_connect(p, p - 1, p - w);
+					break;
+				// |0 0|
+				// |1 1| => 0001'0001 = 17
+				case 17:
+				// |1 1|
+				// |0 0| => 0100'0100 = 68
+				case 68:
+					_zero_connect(p - 1);
+					break;
+				// |0 1|
+				// |0 0| => 0000'0100 = 4
+				case 4:
+				// |1 0|
+				// |1 1| => 0101'0001 = 81
+				case 81:
+					_zero_connect(p - w);
+					break;
+				// |0 1|
+				// |1 0| => 0001'0100 = 20
+				case 20:
+				// |1 0|
+				// |0 1| => 0100'0001 = 65
+				case 65:
+					_zero_connect(p - 1);
+					_zero_connect(p - w);
+					break;
+			}
+		}
+
+		// The window on the bottom border.
+		// We do not check for low contrast.
+		inline void _label_bottom(uint32_t p, uint32_t w, uint8_t mask)
+		{
+			switch (mask)
+			{
+				// |0 0|
+				// |1 1| => 0001'0001 = 17
+				case 17:
+				// |1 1|
+				// |0 0| => 0100'0100 = 68
+				case 68:
+					_new_connect(p, p - 1);
+					break;
+				// |0 1|
+				// |0 0| => 0000'0100 = 4
+				case 4:
+				// |1 0|
+				// |1 1| => 0101'0001 = 81
+				case 81:
+					_new_connect(p, p - w);
+					break;
+				// |0 1|
+				// |1 1| => 0001'0101 = 21
+				case 21:
+				// |1 0|
+				// |0 0| => 0100'0000 = 64
+				case 64:
+					_new_connect(p, p - 1, p - w);
+					break;
+				// |0 0|
+				// |1 0| => 0001'0000 = 16
+				case 16:
+				// |1 1|
+				// |0 1| => 0100'0101 = 69
+				case 69:
+					_zero_connect(p - 1);
+					break;
+				// |0 1|
+				// |0 1| => 0000'0101 = 5
+				case 5:
+				// |1 0|
+				// |1 0| => 0101'0000 = 80
+				case 80:
+					_zero_connect(p - w);
+					break;
+				// |0 1|
+				// |1 0| => 0001'0100 = 20
+				case 20:
+				// |1 0|
+				// |0 1| => 0100'0001 = 65
+				case 65:
+					_zero_connect(p - 1);
+					_zero_connect(p - w);
+					break;
+			}
+		}
+
+		// Labels the windows of the row (p_row - the first pixel) with the bottom right pixel in [x0, x1), x0 >= 1.
+		template <bool bottom>
+		inline void _label_row(const uint8_t* const img, uint32_t w, uint32_t p_row, uint32_t x0, uint32_t x1)
+		{
+			// |d b|
+			// |c a| => 0d0c'0b0a
+			uint32_t p = p_row + x0 - 1;
+			uint8_t mask = (img[p - w] << 2) | img[p];
+			const uint32_t inner_end = p_row + (x1 < w - 1 ? x1 : w - 1);
+			for (++p; p < inner_end; ++p)
+			{
+				mask = (mask << 4) | (img[p - w] << 2) | img[p];
+				if (bottom)
+					_label_bottom(p, w, mask);
+				else
+					_label(p, w, mask);
+			}
+			if (!bottom && x1 == w)
+			{
+				mask = (mask << 4) | (img[p - w] << 2) | img[p];
+				_label_right(p, w, mask);
+			}
+		}
+
+		// Adds the pixel p to its contour.
+		inline void _collect(const uint8_t* const img, uint32_t w, uint32_t size, uint32_t min_contour_size, uint32_t p)
+		{
+			const uint32_t root = _get_root(p);
+			if (root == 0)
+				return;
+			if (_rn[root].n < min_contour_size)
+				return;
+			// Save index into size.
+			uint32_t idx;
+			if (_rn[root].n < size)
+			{
+				idx = _contours.size();
+				_contours.emplace_back(std::vector<cpt_t>());
+				_contours.back().reserve(_rn[root].n);
+				_rn[root].n = size + idx;
+			}
+			else
+				idx = _rn[root].n - size;
+			//
+			const uint16_t y = p / w;
+			const uint16_t x = p - y * w;
+			const uint8_t mask = (img[p - w - 1] << 4) | (img[p - 1] << 4) | (img[p - w] << 2) | img[p];
+			switch (mask)
+			{
+				// |0 1|
+				// |0 1| => 0000'0101 = 5
+				case 5:
+					_contours[idx].emplace_back(x, y, -1, 0);
+					break;
+				// |1 0|
+				// |1 0| => 0101'0000 = 80
+				case 80:
+					_contours[idx].emplace_back(x, y, 1, 0);
+					break;
+				// |0 0|
+				// |1 1| => 0001'0001 = 17
+				case 17:
+					_contours[idx].emplace_back(x, y, 0, -1);
+					break;
+				// |1 1|
+				// |0 0| => 0100'0100 = 68
+				case 68:
+					_contours[idx].emplace_back(x, y, 0, 1);
+					break;
+				// |0 0|
+				// |0 1| => 0000'0001 = 1
+				case 1:
+				// |0 1|
+				// |1 1| => 0001'0101 = 21
+				case 21:
+					_contours[idx].emplace_back(x, y, -1, -1);
+					break;
+				// |1 0|
+				// |0 0| => 0100'0000 = 64
+				case 64:
+				// |1 1|
+				// |1 0| => 0101'0100 = 84
+				case 84:
+					_contours[idx].emplace_back(x, y, 1, 1);
+					break;
+				// |0 1|
+				// |0 0| => 0000'0100 = 4
+				case 4:
+				// |1 1|
+				// |0 1| => 0100'0101 = 69
+				case 69:
+					_contours[idx].emplace_back(x, y, -1, 1);
+					break;
+				// |0 0|
+				// |1 0| => 0001'0000 = 16
+				case 16:
+				// |1 0|
+				// |1 1| => 0101'0001 = 81
+				case 81:
+					_contours[idx].emplace_back(x, y, 1, -1);
+					break;
+				default:
+					_contours[idx].emplace_back(x, y, 0, 0);
+					break;
+			}
+		}
+
 	public:
 		Contours(const cfg_t* cfg) :
 			_cfg(cfg)
 		{
 		}
 
-		std::vector<std::vector<cpt_t>>& calc(const image_t& thresh_img)
+		// With the mask only the windows around its active tiles are labeled.
+		std::vector<std::vector<cpt_t>>& calc(const image_t& thresh_img, const Mask* mask = nullptr)
+		{
+			label(thresh_img, mask);
+			return collect(thresh_img, mask);
+		}
+
+		// The first part of calc: the connected components.
+		// The labels are kept until collect, so an object per frame in flight lets the parts run in different threads (see Pipeline).
+		void label(const image_t& thresh_img, const Mask* mask = nullptr)
 		{
 			const uint8_t* const img = thresh_img.d;
 			const uint32_t w = thresh_img.w;
 			const uint32_t h = thresh_img.h;
 			const uint32_t size = w * h;
+			_time_label = 0.0;
+			_perf_label = perf_t();
+			Stopwatch sw;
 			if (size > _size)
 			{
 				_size = size;
 				_u.resize(size);
 			}
-			std::memset(_u.data(), 0, size * sizeof(uint32_t));
+			if (!mask)
+				std::memset(_u.data(), 0, size * sizeof(uint32_t));
+			else
+			{
+				// Labels are read only in the spans (and in the first row).
+				std::memset(_u.data(), 0, w * sizeof(uint32_t));
+				for (uint32_t y = 1, p = w; y < h; ++y, p += w)
+				{
+					const span_t* s_end;
+					for (const span_t* s = mask->spans(y, s_end); s < s_end; ++s)
+						std::memset(_u.data() + p + s->x0, 0, (s->x1 - s->x0) * sizeof(uint32_t));
+				}
+			}
 			_rn.clear();
 			_rn.reserve(_root_max);
 			_rn.emplace_back(0, 0);
 			_root = 0;
 			// Find connected contours.
-			const uint32_t end = size - w;
-			for (uint32_t p = w; p < end;)
+			if (!mask)
 			{
-				// |d b|
-				// |c a| => 0d0c'0b0a
-				uint8_t mask = (img[p - w] << 2) | img[p];
-				const uint32_t row_end = p + w - 1;
-				++p;
-				for (; p < row_end; ++p)
-				{
-					mask = (mask << 4) | (img[p - w] << 2) | img[p];
-					switch (mask)
-					{
-						// |0 0|
-						// |0 1| => 0000'0001 = 1
-						case 1:
-						// |1 1|
-						// |1 0| => 0101'0100 = 84
-						case 84:
-							_new(p);
-							break;
-						// |0 0|
-						// |1 0| => 0001'0000 = 16
-						case 16:
-						// |0 0|
-						// |1 1| => 0001'0001 = 17
-						case 17:
-						// |1 1|
-						// |0 0| => 0100'0100 = 68
-						case 68:
-						// |1 1|
-						// |0 1| => 0100'0101 = 69
-						case 69:
-							_new_connect(p, p - 1);
-							break;
-						// |0 1|
-						// |0 0| => 0000'0100 = 4
-						case 4:
-						// |0 1|
-						// |0 1| => 0000'0101 = 5
-						case 5:
-						// |1 0|
-						// |1 0| => 0101'0000 = 80
-						case 80:
-						// |1 0|
-						// |1 1| => 0101'0001 = 81
-						case 81:
-							_new_connect(p, p - w);
-							break;
-						// |0 1|
-						// |1 0| => 0001'0100 = 20
-						case 20:
-						// |0 1|
-						// |1 1| => 0001'0101 = 21
-						case 21:
-						// |1 0|
-						// |0 0| => 0100'0000 = 64
-						case 64:
-						// |1 0|
-						// |0 1| => 0100'0001 = 65
-						case 65:
-							_new_connect(p, p - 1, p - w);
-							break;
-						// |0 1|
-						// |1 -| => 0001'0110 = 22
-						case 22:
-						// |1 0|
-						// |0 -| => 0100'0010 = 66
-						case 66:
-							_zero_connect(p - 1);
-							_zero_connect(p - w);
-							break;
-						// |0 0|
-						// |1 -| => 0001'0010 = 18
-						case 18:
-						// |0 -|
-						// |1 -| => 0001'1010 = 26
-						case 26:
-						// |1 1|
-						// |0 -| => 0100'0110 = 70
-						case 70:
-						// |1 -|
-						// |0 -| => 0100'1010 = 74
-						case 74:
-							_zero_connect(p - 1);
-							break;
-						// |0 1|
-						// |0 -| => 0000'0110 = 6
-						case 6:
-						// |0 1|
-						// |- 0| => 0010'0100 = 36
-						case 36:
-						// |0 1|
-						// |- 1| => 0010'0101 = 37
-						case 37:
-						// |0 1|
-						// |- -| => 0010'0110 = 38
-						case 38:
-						// |1 0|
-						// |1 -| => 0101'0010 = 82
-						case 82:
-						// |1 0|
-						// |- 0| => 0110'0000 = 96
-						case 96:
-						// |1 0|
-						// |- 1| => 0110'0001 = 97
-						case 97:
-						// |1 0|
-						// |- -| => 0110'0010 = 98
-						case 98:
-							_zero_connect(p - w);
-							break;
-					}
-				}
-				// Right border.
-				// We do not check for low contrast.
-				{
-					mask = (mask << 4) | (img[p - w] << 2) | img[p];
-					switch (mask)
-					{
-						// |0 0|
-						// |1 0| => 0001'0000 = 16
-						case 16:
-						// |1 1|
-						// |0 1| => 0100'0101 = 69
-						case 69:
-							_new_connect(p, p - 1);
-							break;
-						// |0 1|
-						// |0 1| => 0000'0101 = 5
-						case 5:
-						// |1 0|
-						// |1 0| => 0101'0000 = 80
-						case 80:
-							_new_connect(p, p - w);
-							break;
-						// |0 1|
-						// |1 1| => 0001'0101 = 21
-						case 21:
-						// |1 0|
-						// |0 0| => 0100'0000 = 64
-						case 64:
-							_new_connect(p, p - 1, p - w);
-							break;
-						// |0 0|
-						// |1 1| => 0001'0001 = 17
-						case 17:
-						// |1 1|
-						// |0 0| => 0100'0100 = 68
-						case 68:
-							_zero_connect(p - 1);
-							break;
-						// |0 1|
-						// |0 0| => 0000'0100 = 4
-						case 4:
-						// |1 0|
-						// |1 1| => 0101'0001 = 81
-						case 81:
-							_zero_connect(p - w);
-							break;
-						// |0 1|
-						// |1 0| => 0001'0100 = 20
-						case 20:
-						// |1 0|
-						// |0 1| => 0100'0001 = 65
-						case 65:
-							_zero_connect(p - 1);
-							_zero_connect(p - w);
-							break;
-					}
-					++p;
-				}
+				const uint32_t end = size - w;
+				for (uint32_t p = w; p < end; p += w)
+					_label_row<false>(img, w, p, 1, w);
+				_label_row<true>(img, w, end, 1, w);
 			}
-			// Bottom border.
-			// We do not check for low contrast.
+			else
 			{
-				uint32_t p = end;
-				uint8_t mask = (img[p - w] << 2) | img[p];
-				const uint32_t row_end = p + w - 1;
-				++p;
-				for (; p < row_end; ++p)
+				// Only the spans around the active tiles, other windows consist of unknown pixels.
+				for (uint32_t y = 1, p = w; y < h; ++y, p += w)
 				{
-					mask = (mask << 4) | (img[p - w] << 2) | img[p];
-					switch (mask)
+					const span_t* s_end;
+					for (const span_t* s = mask->spans(y, s_end); s < s_end; ++s)
 					{
-						// |0 0|
-						// |1 1| => 0001'0001 = 17
-						case 17:
-						// |1 1|
-						// |0 0| => 0100'0100 = 68
-						case 68:
-							_new_connect(p, p - 1);
-							break;
-						// |0 1|
-						// |0 0| => 0000'0100 = 4
-						case 4:
-						// |1 0|
-						// |1 1| => 0101'0001 = 81
-						case 81:
-							_new_connect(p, p - w);
-							break;
-						// |0 1|
-						// |1 1| => 0001'0101 = 21
-						case 21:
-						// |1 0|
-						// |0 0| => 0100'0000 = 64
-						case 64:
-							_new_connect(p, p - 1, p - w);
-							break;
-						// |0 0|
-						// |1 0| => 0001'0000 = 16
-						case 16:
-						// |1 1|
-						// |0 1| => 0100'0101 = 69
-						case 69:
-							_zero_connect(p - 1);
-							break;
-						// |0 1|
-						// |0 1| => 0000'0101 = 5
-						case 5:
-						// |1 0|
-						// |1 0| => 0101'0000 = 80
-						case 80:
-							_zero_connect(p - w);
-							break;
-						// |0 1|
-						// |1 0| => 0001'0100 = 20
-						case 20:
-						// |1 0|
-						// |0 1| => 0100'0001 = 65
-						case 65:
-							_zero_connect(p - 1);
-							_zero_connect(p - w);
-							break;
+						const uint32_t x0 = s->x0 > 0 ? s->x0 : 1;
+						if (x0 >= s->x1)
+							continue;
+						if (y < h - 1)
+							_label_row<false>(img, w, p, x0, s->x1);
+						else
+							_label_row<true>(img, w, p, x0, s->x1);
 					}
 				}
 			}
@@ -390,96 +547,89 @@ namespace maytag::_
 				if (_root_max > size)
 					_root_max = size;
 			}
+			sw.lap(_time_label, _perf_label);
+		}
+
+		// The second part of calc: the contour points of the labeled components (the same thresh_img and mask as label).
+		std::vector<std::vector<cpt_t>>& collect(const image_t& thresh_img, const Mask* mask = nullptr)
+		{
+			const uint8_t* const img = thresh_img.d;
+			const uint32_t w = thresh_img.w;
+			const uint32_t h = thresh_img.h;
+			const uint32_t size = w * h;
+			_time_collect = 0.0;
+			_perf_collect = perf_t();
+			Stopwatch sw;
 			// Collect contours.
 			_contours.clear();
 			_contours.reserve(_contour_max);
 			const uint32_t min_contour_size = _cfg->min_contour_size;
-			for (uint32_t p = w + 1; p < size; ++p)
+			_stat = contour_stat_t();
+			for (uint32_t i = 1; i <= _root; ++i)
 			{
-				const uint32_t root = _get_root(p);
-				if (root == 0)
-					continue;
-				if (_rn[root].n < min_contour_size)
+				if (_rn[i].r != i)
 					continue;
-				// Save index into size.
-				uint32_t idx;
-				if (_rn[root].n < size)
+				++_stat.components;
+				if (_rn[i].n < min_contour_size)
+					++_stat.small;
+			}
+			if (!mask)
+			{
+				for (uint32_t p = w + 1; p < size; ++p)
 				{
-					idx = _contours.size();
-					_contours.emplace_back(std::vector<cpt_t>());
-					_contours.back().reserve(_rn[root].n);
-					_rn[root].n = size + idx;
+					if (_u[p] != 0)
+						_collect(img, w, size, min_contour_size, p);
 				}
-				else
-					idx = _rn[root].n - size;
-				//
-				const uint16_t y = p / w;
-				const uint16_t x = p - y * w;
-				const uint8_t mask = (img[p - w - 1] << 4) | (img[p - 1] << 4) | (img[p - w] << 2) | img[p];
-				switch (mask)
+			}
+			else
+			{
+				for (uint32_t y = 1, p = w; y < h; ++y, p += w)
 				{
-					// |0 1|
-					// |0 1| => 0000'0101 = 5
-					case 5:
-						_contours[idx].emplace_back(x, y, -1, 0);
-						break;
-					// |1 0|
-					// |1 0| => 0101'0000 = 80
-					case 80:
-						_contours[idx].emplace_back(x, y, 1, 0);
-						break;
-					// |0 0|
-					// |1 1| => 0001'0001 = 17
-					case 17:
-						_contours[idx].emplace_back(x, y, 0, -1);
-						break;
-					// |1 1|
-					// |0 0| => 0100'0100 = 68
-					case 68:
-						_contours[idx].emplace_back(x, y, 0, 1);
-						break;
-					// |0 0|
-					// |0 1| => 0000'0001 = 1
-					case 1:
-					// |0 1|
-					// |1 1| => 0001'0101 = 21
-					case 21:
-						_contours[idx].emplace_back(x, y, -1, -1);
-						break;
-					// |1 0|
-					// |0 0| => 0100'0000 = 64
-					case 64:
-					// |1 1|
-					// |1 0| => 0101'0100 = 84
-					case 84:
-						_contours[idx].emplace_back(x, y, 1, 1);
-						break;
-					// |0 1|
-					// |0 0| => 0000'0100 = 4
-					case 4:
-					// |1 1|
-					// |0 1| => 0100'0101 = 69
-					case 69:
-						_contours[idx].emplace_back(x, y, -1, 1);
-						break;
-					// |0 0|
-					// |1 0| => 0001'0000 = 16
-					case 16:
-					// |1 0|
-					// |1 1| => 0101'0001 = 81
-					case 81:
-						_contours[idx].emplace_back(x, y, 1, -1);
-						break;
-					default:
-						_contours[idx].emplace_back(x, y, 0, 0);
-						break;
+					const span_t* s_end;
+					for (const span_t* s = mask->spans(y, s_end); s < s_end; ++s)
+					{
+						for (uint32_t x = (s->x0 > 0 ? s->x0 : 1); x < s->x1; ++x)
+						{
+							if (_u[p + x] != 0)
+								_collect(img, w, size, min_contour_size, p + x);
+						}
+					}
 				}
 			}
 			// 
 			if (_contours.size() > _contour_max)
 				_contour_max = _contours.size() + _contours.size() / 10;
+			_stat.contours = _contours.size();
+			sw.lap(_time_collect, _perf_collect);
 
 			return _contours;
 		}
+
+		const contour_stat_t& stat() const
+		{
+			return _stat;
+		}
+
+		// Bytes held (the contour points of the last frame are released by the next calc).
+		size_t memory() const
+		{
+			size_t size = _u.capacity() * sizeof(uint32_t) + _rn.capacity() * sizeof(rn_t)
+				+ _contours.capacity() * sizeof(std::vector<cpt_t>);
+			for (const auto& contour : _contours)
+				size += contour.capacity() * sizeof(cpt_t);
+			return size;
+		}
+
+		void timing_label(timing_t& t, perf_stat_t& p) const
+		{
+			t.contour_label = _time_label;
+			p.contour_label = _perf_label;
+		}
+
+		void timing_collect(timing_t& t, perf_stat_t& p) const
+		{
+			t.contour_collect = _time_collect;
+			p.contour_collect = _perf_collect;
+		}
 	};
 }
\ No newline at end of file
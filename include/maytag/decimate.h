@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include "cfg.h"
@@ -96,5 +97,11 @@ namespace maytag::_
 				return image_t(dw, dh, _ptr);
 			}
 		}
+
+		// Bytes held.
+		size_t memory() const
+		{
+			return _size;
+		}
 	};
 }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "cfg.h"
 #include "quad.h"
@@ -9,71 +14,166 @@
 #include "graymodel.h"
 #include "tag_family.h"
 #include "tag.h"
+#include "timing.h"
+#include "trace.h"
 
 
 namespace maytag::_
 {
+	// Decode counters of the last frame.
+	struct decode_stat_t
+	{
+		uint32_t quads = 0;       // Input quads.
+		uint32_t homography = 0;  // Quads without the homography (degenerate corners).
+		uint32_t candidates = 0;  // Quad and tag family pairs.
+		uint32_t prefiltered = 0; // Rejected by the prefilter before the full sampling.
+		uint32_t polarity = 0;    // Border models of the other color.
+		uint32_t one_color = 0;   // All bits of one color.
+		uint32_t low_score = 0;   // Score less than min_score.
+		uint32_t dict_miss = 0;   // No code in the dictionary.
+		uint32_t dict_hamming = 0; // Code found with more errors than the family hamming.
+		uint32_t chased = 0;      // Tags found by the soft decision decoding.
+		uint32_t tags = 0;        // Output tags.
+
+		inline void operator+=(const decode_stat_t& v)
+		{
+			quads += v.quads;
+			homography += v.homography;
+			candidates += v.candidates;
+			prefiltered += v.prefiltered;
+			polarity += v.polarity;
+			one_color += v.one_color;
+			low_score += v.low_score;
+			dict_miss += v.dict_miss;
+			dict_hamming += v.dict_hamming;
+			chased += v.chased;
+			tags += v.tags;
+		}
+	};
+
+	// Per-worker decode state.
+	// Each worker thread owns one context, so quads can be decoded in parallel.
+	template <typename T>
+	struct decode_ctx_t
+	{
+		T h[9];
+		std::vector<T> val;
+		std::vector<T> tmp;
+		T rel[64];  // Reliability of the code bits (by bit position).
+		std::vector<tag_t> tags;
+		decode_stat_t stat;
+		double time_dict = 0.0;
+
+		void init(uint32_t size)
+		{
+			const uint32_t size_2 = size * size;
+			if (val.size() < size_2)
+			{
+				val.resize(size_2);
+				tmp.resize(size_2);
+			}
+		}
+	};
+
+	template <typename T>
 	class Decode
 	{
 	private:
 		const cfg_t* const _cfg;
-		double _h[9];
-		uint32_t _size = 0;
-		double* _val = nullptr;
-		double* _tmp = nullptr;
+		std::vector<decode_ctx_t<T>> _ctx;
 		std::vector<tag_t> _tags;
+		decode_stat_t _stat;
+		double _time = 0.0;
+		double _time_dict = 0.0;
+		perf_t _perf;
+		// Config in the precision of the math (see update_cfg).
+		T _decode_sharpening;
+		T _min_score;
+		T _prefilter_min_diff;
+		// Worker pool: the thread t (t >= 1) decodes with _ctx[t], it waits for the next frame between the frames.
+		std::vector<std::thread> _threads;
+		std::mutex _mutex;
+		std::condition_variable _start_cv;
+		std::condition_variable _done_cv;
+		uint64_t _job = 0;          // Generation of the frame job.
+		uint32_t _job_threads = 0;  // Threads of the job (including the calling thread).
+		uint32_t _running = 0;      // Workers that have not finished the job.
+		bool _stop = false;
+		const std::vector<basic_quad_t<T>>* _job_quads = nullptr;
+		const image_t* _job_img = nullptr;
+		uint32_t _job_frame = 0;
 
-		void _init_ptr(uint32_t size)
+		// job - the last job seen (the thread starts with the next one).
+		void _worker(uint32_t t, uint64_t job)
 		{
-			if (size <= _size)
-				return;
-			_size = size;
-			if (_val)
-				delete[] _val;
-			_val = new double[2 * _size * _size];
-			_tmp = _val + _size * _size;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_start_cv.wait(lock, [this, job]() { return _stop || _job != job; });
+					if (_stop)
+						return;
+					job = _job;
+					if (t >= _job_threads)
+						continue;
+				}
+				const uint32_t size = _job_quads->size();
+				const uint32_t beg = size * t / _job_threads;
+				const uint32_t end = size * (t + 1) / _job_threads;
+				trace_begin("decode worker", _job_frame);
+				_ctx[t].tags.clear();
+				_decode(_ctx[t], *_job_quads, beg, end, *_job_img, _ctx[t].tags);
+				trace_end("decode worker", _job_frame);
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					if (--_running == 0)
+						_done_cv.notify_one();
+				}
+			}
 		}
 
-		void _sharpen(const uint32_t size)
+		void _sharpen(decode_ctx_t<T>& ctx, const uint32_t size) const
 		{
 			// Kernel:
 			// | 0 -1  0|
 			// |-1  4 -1|
 			// | 0 -1  0|
+			T* const val = ctx.val.data();
+			T* const tmp = ctx.tmp.data();
 			for (uint32_t y = 0, p = 0; y < size; ++y)
 			{
 				for (uint32_t x = 0; x < size; ++x, ++p)
 				{
-					double v = 4.0 * _val[p];
+					T v = T(4) * val[p];
 					if (y > 0)
-						v -= _val[p - size];
+						v -= val[p - size];
 					if (x > 0)
-						v -= _val[p - 1];
+						v -= val[p - 1];
 					if (x < size - 1)
-						v -= _val[p + 1];
+						v -= val[p + 1];
 					if (y < size - 1)
-						v -= _val[p + size];
-					_tmp[p] = v;
+						v -= val[p + size];
+					tmp[p] = v;
 				}
 			}
 			const uint32_t size_2 = size * size;
-			const double decode_sharpening = _cfg->decode_sharpening;
+			const T decode_sharpening = _decode_sharpening;
 			for (uint32_t p = 0; p < size_2; ++p)
-				_val[p] += decode_sharpening * _tmp[p];
+				val[p] += decode_sharpening * tmp[p];
 		}
 
-		bool _calc_homography(const quad_t& quad)
+		bool _calc_homography(const basic_quad_t<T>& quad, T* const h) const
 		{
 			// 3---2
 			// | + |
 			// 0---1
-			const double c[4][4] = {
-				{0.0, 0.0, quad.p[3].x, quad.p[3].y},
-				{0.0, 1.0, quad.p[0].x, quad.p[0].y},
-				{1.0, 1.0, quad.p[1].x, quad.p[1].y},
-				{1.0, 0.0, quad.p[2].x, quad.p[2].y}
+			const T c[4][4] = {
+				{T(0), T(0), quad.p[3].x, quad.p[3].y},
+				{T(0), T(1), quad.p[0].x, quad.p[0].y},
+				{T(1), T(1), quad.p[1].x, quad.p[1].y},
+				{T(1), T(0), quad.p[2].x, quad.p[2].y}
 			};
-			double a[] = {
+			T a[] = {
 				c[0][0], c[0][1], 1.0,     0.0,     0.0, 0.0, -c[0][0] * c[0][2], -c[0][1] * c[0][2], c[0][2],
 				    0.0,     0.0, 0.0, c[0][0], c[0][1], 1.0, -c[0][0] * c[0][3], -c[0][1] * c[0][3], c[0][3],
 				c[1][0], c[1][1], 1.0,     0.0,     0.0, 0.0, -c[1][0] * c[1][2], -c[1][1] * c[1][2], c[1][2],
@@ -87,25 +187,26 @@ namespace maytag::_
 			for (int col = 0; col < 8; col++)
 			{
 				// Find best row to swap with.
-				double max_val = 0;
+				T max_val = T(0);
 				int max_val_idx = -1;
 				for (int row = col; row < 8; row++)
 				{
-					double val = std::abs(a[row * 9 + col]);
+					using std::abs;
+					T val = abs(a[row * 9 + col]);
 					if (val > max_val)
 					{
 						max_val = val;
 						max_val_idx = row;
 					}
 				}
-				if (max_val < 1e-9)
+				if (max_val <= T(1e-9))
 					return false;
 				// Swap to get best row.
 				if (max_val_idx != col)
 				{
 					for (int i = col; i < 9; i++)
 					{
-						double tmp = a[col * 9 + i];
+						T tmp = a[col * 9 + i];
 						a[col * 9 + i] = a[max_val_idx * 9 + i];
 						a[max_val_idx * 9 + i] = tmp;
 					}
@@ -113,8 +214,8 @@ namespace maytag::_
 				// Do eliminate.
 				for (int i = col + 1; i < 8; i++)
 				{
-					double f = a[i * 9 + col] / a[col * 9 + col];
-					a[i * 9 + col] = 0;
+					T f = a[i * 9 + col] / a[col * 9 + col];
+					a[i * 9 + col] = T(0);
 					for (int j = col + 1; j < 9; j++)
 						a[i * 9 + j] -= f * a[col * 9 + j];
 				}
@@ -122,106 +223,190 @@ namespace maytag::_
 			// Back solve.
 			for (int col = 7; col >= 0; col--)
 			{
-				double sum = 0;
+				T sum = T(0);
 				for (int i = col + 1; i < 8; i++)
 					sum += a[col * 9 + i] * a[i * 9 + 8];
 				a[col * 9 + 8] = (a[col * 9 + 8] - sum) / a[col * 9 + col];
 			}
-			_h[0] = a[8];
-			_h[1] = a[17];
-			_h[2] = a[26];
-			_h[3] = a[35];
-			_h[4] = a[44];
-			_h[5] = a[53];
-			_h[6] = a[62];
-			_h[7] = a[71];
-			_h[8] = 1.0;
+			h[0] = a[8];
+			h[1] = a[17];
+			h[2] = a[26];
+			h[3] = a[35];
+			h[4] = a[44];
+			h[5] = a[53];
+			h[6] = a[62];
+			h[7] = a[71];
+			h[8] = T(1);
 			return true;
 		}
 
 		// h - 3x3 dimansion.
 		// x, y - coordinates in tag space [0, 1].
 		// px, py - coordinates (pixels) in image space.
-		void _homography_project(const double* h, double x, double y, double& px, double& py) const
+		void _homography_project(const T* h, T x, T y, T& px, T& py) const
 		{
-			double xx = h[0] * x + h[1] * y + h[2];
-			double yy = h[3] * x + h[4] * y + h[5];
-			double zz = h[6] * x + h[7] * y + h[8];
+			T xx = h[0] * x + h[1] * y + h[2];
+			T yy = h[3] * x + h[4] * y + h[5];
+			T zz = h[6] * x + h[7] * y + h[8];
 			px = xx / zz;
 			py = yy / zz;
 		}
 
-		void _add_model(const image_t& gray_img, graymodel_t& model, double tx, double ty) const
+		void _add_model(const T* const h, const image_t& gray_img, graymodel_t<T>& model, T tx, T ty) const
 		{
-			double px, py;
-			_homography_project(_h, tx, ty, px, py);
+			T px, py;
+			_homography_project(h, tx, ty, px, py);
 			// don't round
 			int ix = static_cast<int>(px);
 			int iy = static_cast<int>(py);
 			if (ix >= 0 && iy >= 0 && ix < gray_img.w && iy < gray_img.h)
-				model.add(tx, ty, gray_img.d[iy * gray_img.w + ix]);
+				model.add(tx, ty, T(gray_img.d[iy * gray_img.w + ix]));
+		}
+
+		// Gray value of the pixel at tag coordinates (tx, ty).
+		inline bool _sample(const T* const h, const image_t& gray_img, T tx, T ty, int& v) const
+		{
+			T px, py;
+			_homography_project(h, tx, ty, px, py);
+			int ix = static_cast<int>(px);
+			int iy = static_cast<int>(py);
+			if (ix < 0 || iy < 0 || static_cast<uint32_t>(ix) >= gray_img.w || static_cast<uint32_t>(iy) >= gray_img.h)
+				return false;
+			v = gray_img.d[iy * gray_img.w + ix];
+			return true;
+		}
+
+		// Cheap check before the full sampling of the tag.
+		// 1. Compares pairs of cells on both sides of the border: white cells outside and black cells inside.
+		//    Two pairs on each side of the quad, away from the corners.
+		// 2. Any code has both white and black bits, so the bit cells can't all have the same color.
+		//    Stops at the first pair of the light and dark bits (usually after a few samples).
+		bool _prefilter(const T* const h, const tag_family_t& family, const image_t& gray_img) const
+		{
+			const uint32_t wb = family.width_at_border;
+			const T d_full = T(1) / T(wb);
+			const T d_half = T(0.5) * d_full;
+			const T d_out = -d_half;
+			const T d_in = d_half;
+			const T d[2] = {d_half + d_full, T(1) - d_half - d_full};
+			int diff_sum = 0;
+			int out_sum = 0;
+			int in_sum = 0;
+			uint32_t count = 0;
+			uint32_t good = 0;
+			for (uint32_t i = 0; i < 2; ++i)
+			{
+				// Left, right, top and bottom.
+				const T pair[4][4] = {
+					{d_out, d[i], d_in, d[i]},
+					{T(1) - d_out, d[i], T(1) - d_in, d[i]},
+					{d[i], d_out, d[i], d_in},
+					{d[i], T(1) - d_out, d[i], T(1) - d_in}
+				};
+				for (uint32_t j = 0; j < 4; ++j)
+				{
+					int v_out, v_in;
+					if (!_sample(h, gray_img, pair[j][0], pair[j][1], v_out))
+						continue;
+					if (!_sample(h, gray_img, pair[j][2], pair[j][3], v_in))
+						continue;
+					const int diff = family.black ? v_out - v_in : v_in - v_out;
+					diff_sum += diff;
+					out_sum += v_out;
+					in_sum += v_in;
+					++count;
+					if (diff > 0)
+						++good;
+				}
+			}
+			// At most one pair with the wrong contrast.
+			if (count < 4 || good + 1 < count)
+				return false;
+			if (T(diff_sum) < _prefilter_min_diff * T(count))
+				return false;
+			// The light and dark levels with a margin of a quarter of the contrast.
+			const int out_mean = out_sum / static_cast<int>(count);
+			const int in_mean = in_sum / static_cast<int>(count);
+			const int margin = (out_mean - in_mean) / 4;
+			const int dark = std::min(out_mean, in_mean) + std::abs(margin);
+			const int light = std::max(out_mean, in_mean) - std::abs(margin);
+			bool is_dark = false;
+			bool is_light = false;
+			for (uint32_t i = 0; i < family.nbits; ++i)
+			{
+				int v;
+				if (!_sample(h, gray_img, d_half + T(family.bit_x[i]) * d_full, d_half + T(family.bit_y[i]) * d_full, v))
+					continue;
+				if (v <= dark)
+					is_dark = true;
+				else if (v >= light)
+					is_light = true;
+				if (is_dark && is_light)
+					return true;
+			}
+			return false;
 		}
 
 		// Decode the tag binary contents by sampling the pixel closest to the center of each bit cell.
 		// We will compute a threshold by sampling known white/black cells around this tag.
 		// This sampling is achieved by considering a set of samples along lines.
-		uint64_t _quad_code(const quad_t& quad, const tag_family_t& family, const image_t& gray_img, double& score)
+		uint64_t _quad_code(decode_ctx_t<T>& ctx, const tag_family_t& family, const image_t& gray_img, T& score) const
 		{
+			const T* const hom = ctx.h;
+			T* const val = ctx.val.data();
 			const uint32_t wb = family.width_at_border;
 			const uint32_t tw = family.total_width;
 			const uint32_t nbits = family.nbits;
 			// Tag coordinates in range [0, 1].
 			// Tag bit size.
-			const double d_full = 1.0 / wb;
+			const T d_full = T(1) / T(wb);
 			// Tag bit falf size.
-			const double d_half = 0.5 * d_full;
+			const T d_half = T(0.5) * d_full;
 			//
-			graymodel_t white_model;
-			graymodel_t black_model;
+			graymodel_t<T> white_model;
+			graymodel_t<T> black_model;
 			// Left, right, top and bottom white columns.
 			{
-				const double d1 = -d_half;
-				const double d2 = 1.0 + d_half;
-				double d = d_half;
+				const T d1 = -d_half;
+				const T d2 = T(1) + d_half;
+				T d = d_half;
 				for (uint32_t i = 0; i < wb; ++i, d += d_full)
 				{
-					_add_model(gray_img, white_model, d1, d);
-					_add_model(gray_img, white_model, d2, d);
-					_add_model(gray_img, white_model, d, d1);
-					_add_model(gray_img, white_model, d, d2);
+					_add_model(hom, gray_img, white_model, d1, d);
+					_add_model(hom, gray_img, white_model, d2, d);
+					_add_model(hom, gray_img, white_model, d, d1);
+					_add_model(hom, gray_img, white_model, d, d2);
 				}
 			}
 			// Left, right, top and bottom black columns.
 			{
-				const double d1 = d_half;
-				const double d2 = 1.0 - d_half;
-				double d = d_half + d_full;
+				const T d1 = d_half;
+				const T d2 = T(1) - d_half;
+				T d = d_half + d_full;
 				for (uint32_t i = 2; i < wb; ++i, d += d_full)
 				{
-					_add_model(gray_img, black_model, d1, d);
-					_add_model(gray_img, black_model, d2, d);
-					_add_model(gray_img, black_model, d, d1);
-					_add_model(gray_img, black_model, d, d2);
+					_add_model(hom, gray_img, black_model, d1, d);
+					_add_model(hom, gray_img, black_model, d2, d);
+					_add_model(hom, gray_img, black_model, d, d1);
+					_add_model(hom, gray_img, black_model, d, d2);
 				}
 				// Corners.
-				_add_model(gray_img, black_model, d1, d1);
-				_add_model(gray_img, black_model, d1, d2);
-				_add_model(gray_img, black_model, d2, d1);
-				_add_model(gray_img, black_model, d2, d2);
+				_add_model(hom, gray_img, black_model, d1, d1);
+				_add_model(hom, gray_img, black_model, d1, d2);
+				_add_model(hom, gray_img, black_model, d2, d1);
+				_add_model(hom, gray_img, black_model, d2, d2);
 			}
 			//
 			white_model.solve();
 			black_model.solve();
 			//
-			if (white_model.interpolate(0.0, 0.0) < black_model.interpolate(0.0, 0.0))
+			if ((white_model.interpolate(T(0), T(0)) < black_model.interpolate(T(0), T(0))) == family.black)
 			{
-				if (family.black)
-					return std::numeric_limits<uint64_t>::max();
-			}
-			else if (!family.black)
+				++ctx.stat.polarity;
 				return std::numeric_limits<uint64_t>::max();
+			}
 			//
-			std::memset(_val, 0, tw * tw * sizeof(double));
+			std::fill(val, val + tw * tw, T(0));
 			const uint32_t beg_coord = (tw + 1) * (tw - wb) / 2;
 			const uint8_t* const img = gray_img.d;
 			const uint32_t w = gray_img.w;
@@ -230,31 +415,31 @@ namespace maytag::_
 			{
 				uint32_t bit_x = family.bit_x[i];
 				uint32_t bit_y = family.bit_y[i];
-				double tx = d_half + bit_x * d_full;
-				double ty = d_half + bit_y * d_full;
-				double px, py;
-				_homography_project(_h, tx, ty, px, py);
+				T tx = d_half + T(bit_x) * d_full;
+				T ty = d_half + T(bit_y) * d_full;
+				T px, py;
+				_homography_project(hom, tx, ty, px, py);
 				// Interpolate.
-				double v = 0.5 * (black_model.interpolate(tx, ty) + white_model.interpolate(tx, ty));
+				T v = T(0.5) * (black_model.interpolate(tx, ty) + white_model.interpolate(tx, ty));
 				if (_cfg->interpolate)
 				{
-					px -= 0.5;
-					py -= 0.5;
+					px -= T(0.5);
+					py -= T(0.5);
 					int xi = static_cast<int>(px);
 					int yi = static_cast<int>(py);
 					if (xi < 0 || yi < 0 || xi >= w - 1 || yi >= h - 1)
 						continue;
 					const uint32_t p = yi * w + xi;
-					px -= xi;
-					py -= yi;
-					uint8_t i00 = img[p];
-					uint8_t i10 = img[p + 1];
-					uint8_t i01 = img[p + w];
-					uint8_t i11 = img[p + w + 1];
-					double w11 = px * py;
-					double w10 = px - w11;
-					double w01 = py - w11;
-					double w00 = 1.0 + w11 - px - py;
+					px -= T(xi);
+					py -= T(yi);
+					const T i00 = T(img[p]);
+					const T i10 = T(img[p + 1]);
+					const T i01 = T(img[p + w]);
+					const T i11 = T(img[p + w + 1]);
+					T w11 = px * py;
+					T w10 = px - w11;
+					T w01 = py - w11;
+					T w00 = T(1) + w11 - px - py;
 					v -= i00 * w00 + i10 * w10 + i01 * w01 + i11 * w11;
 				}
 				else
@@ -264,19 +449,19 @@ namespace maytag::_
 					if (xi < 0 || yi < 0 || xi >= w || yi >= h)
 						continue;
 					const uint32_t p = yi * w + xi;
-					v -= img[p];
+					v -= T(img[p]);
 				}
 				const uint32_t idx = beg_coord + tw * bit_y + bit_x;
 				if (family.black)
-					_val[idx] = -v;
+					val[idx] = -v;
 				else
-					_val[idx] = v;
+					val[idx] = v;
 			}
 			// Sharpen.
-			_sharpen(tw);
+			_sharpen(ctx, tw);
 			//
-			double black_score = 0.0;
-			double white_score = 0.0;
+			T black_score = T(0);
+			T white_score = T(0);
 			uint32_t black_score_count = 0;
 			uint32_t white_score_count = 0;
 			uint64_t code = 0;
@@ -285,8 +470,9 @@ namespace maytag::_
 				code <<= 1;
 				uint32_t bit_x = family.bit_x[i];
 				uint32_t bit_y = family.bit_y[i];
-				double v = _val[beg_coord + tw * bit_y + bit_x];
-				if (v > 0)
+				T v = val[beg_coord + tw * bit_y + bit_x];
+				ctx.rel[nbits - 1 - i] = v > T(0) ? v : -v;
+				if (v > T(0))
 				{
 					white_score += v;
 					white_score_count++;
@@ -299,70 +485,268 @@ namespace maytag::_
 				}
 			}
 			if (white_score_count == 0 || black_score_count == 0)
+			{
+				++ctx.stat.one_color;
 				return std::numeric_limits<uint64_t>::max();
-			score = std::min(white_score / white_score_count, black_score / black_score_count);
-			if (score < _cfg->min_score)
+			}
+			score = std::min(white_score / T(white_score_count), black_score / T(black_score_count));
+			if (score < _min_score)
+			{
+				++ctx.stat.low_score;
 				return std::numeric_limits<uint64_t>::max();
+			}
 			return code;
 		}
 
-		//
-		inline void _tag_rotate(uint8_t rot, const pt_t* const p_src, pt_t* const p_dest) const
-		{
-			for (uint8_t i = 0; i < 4; ++i)
-				p_dest[(i + rot) & 3] = p_src[i];
-		}
-
-	public:
-		Decode(const cfg_t* cfg) :
-			_cfg(cfg)
+		// Chase decoding: flip the combinations of the least reliable bits and query the dictionary.
+		// The candidate with the minimum sum of reliabilities of the corrected bits wins.
+		bool _chase(const decode_ctx_t<T>& ctx, const tag_family_t& family, const Dictionary& dict, uint64_t code, uint16_t& id, uint8_t& hamming, uint8_t& rot) const
 		{
+			const uint32_t nbits = family.nbits;
+			uint32_t nflip = _cfg->chase_bits;
+			if (nflip > nbits)
+				nflip = nbits;
+			// The least reliable bits (selection, nflip is small).
+			uint32_t pos[8];
+			uint64_t used = 0;
+			for (uint32_t k = 0; k < nflip; ++k)
+			{
+				uint32_t best = nbits;
+				for (uint32_t b = 0; b < nbits; ++b)
+				{
+					if (((used >> b) & 1) == 0 && (best == nbits || ctx.rel[b] < ctx.rel[best]))
+						best = b;
+				}
+				pos[k] = best;
+				used |= static_cast<uint64_t>(1) << best;
+			}
+			bool found = false;
+			T best_cost = T(0);
+			for (uint32_t pattern = 1; pattern < (1u << nflip); ++pattern)
+			{
+				uint64_t flip = 0;
+				for (uint32_t k = 0; k < nflip; ++k)
+				{
+					if ((pattern >> k) & 1)
+						flip |= static_cast<uint64_t>(1) << pos[k];
+				}
+				uint16_t c_id;
+				uint8_t c_hamming;
+				uint8_t c_rot;
+				if (!dict.decode(code ^ flip, c_id, c_hamming, c_rot))
+					continue;
+				// Distance from the hard code (the flips and the dictionary corrections may overlap).
+				const uint64_t err = dict.error(code, c_id, c_rot);
+				const uint32_t d = Dictionary::popcount(err);
+				if (d > family.hamming)
+					continue;
+				T cost = T(0);
+				for (uint32_t b = 0; b < nbits; ++b)
+				{
+					if ((err >> b) & 1)
+						cost += ctx.rel[b];
+				}
+				if (!found || cost < best_cost)
+				{
+					found = true;
+					best_cost = cost;
+					id = c_id;
+					hamming = static_cast<uint8_t>(d);
+					rot = c_rot;
+				}
+			}
+			return found;
 		}
 
-		~Decode()
+		// The corners are converted to double only here (tag_t is the same for all detectors).
+		inline void _tag_rotate(uint8_t rot, const basic_pt_t<T>* const p_src, pt_t* const p_dest) const
 		{
-			if (_val)
-				delete[] _val;
+			for (uint8_t i = 0; i < 4; ++i)
+			{
+				p_dest[(i + rot) & 3].x = static_cast<double>(p_src[i].x);
+				p_dest[(i + rot) & 3].y = static_cast<double>(p_src[i].y);
+			}
 		}
 
-		const std::vector<tag_t>& calc(const std::vector<quad_t>& quads, const image_t& gray_img)
+		// Decode quads [beg, end) and append the found tags.
+		void _decode(decode_ctx_t<T>& ctx, const std::vector<basic_quad_t<T>>& quads, uint32_t beg, uint32_t end, const image_t& gray_img, std::vector<tag_t>& tags) const
 		{
-			_tags.clear();
-			const uint32_t size = quads.size();
-			if (size == 0)
-				return _tags;
 			const auto& tag_family = _cfg->tag_family;
 			const uint32_t tag_family_size = tag_family.size();
-			if (tag_family_size == 0)
-				return _tags;
-			_init_ptr(_cfg->max_total_width);
-			_tags.reserve(size);
 			tag_t tag;
-			for (uint32_t i = 0; i < size; ++i)
+			for (uint32_t i = beg; i < end; ++i)
 			{
 				const auto& quad = quads[i];
-				if (!_calc_homography(quad))
+				++ctx.stat.quads;
+				if (!_calc_homography(quad, ctx.h))
+				{
+					++ctx.stat.homography;
 					continue;
+				}
 				for (int fi = 0; fi < tag_family_size; ++fi)
 				{
 					const auto& family = tag_family[fi];
 					if (family.black != quad.black)
 						continue;
-					uint64_t code = _quad_code(quad, family, gray_img, tag.score);
+					++ctx.stat.candidates;
+					if (_cfg->prefilter && !_prefilter(ctx.h, family, gray_img))
+					{
+						++ctx.stat.prefiltered;
+						continue;
+					}
+					T score;
+					uint64_t code = _quad_code(ctx, family, gray_img, score);
 					if (code == std::numeric_limits<uint64_t>::max())
 						continue;
 					uint8_t rot;
-					if (!_cfg->tag_dict[fi]->decode(code, tag.id, tag.hamming, rot))
-						continue;
-					if (tag.hamming > family.hamming)
+					const Dictionary& dict = *_cfg->tag_dict[fi];
+					Stopwatch sw(false);
+					bool found = dict.decode(code, tag.id, tag.hamming, rot);
+					const bool in_dict = found;
+					if (found && tag.hamming > family.hamming)
+						found = false;
+					if (!found && _cfg->chase_bits > 0)
+					{
+						found = _chase(ctx, family, dict, code, tag.id, tag.hamming, rot);
+						if (found)
+							++ctx.stat.chased;
+					}
+					sw.lap(ctx.time_dict);
+					if (!found)
+					{
+						if (in_dict)
+							++ctx.stat.dict_hamming;
+						else
+							++ctx.stat.dict_miss;
 						continue;
+					}
 					_tag_rotate(rot, quad.p, tag.p);
+					tag.score = static_cast<double>(score);
 					tag.black = quad.black;
-					tag.name = family.name;
-					_tags.emplace_back(tag);
+					tag.family = fi;
+					tags.emplace_back(tag);
+					++ctx.stat.tags;
 				}
 			}
+		}
+
+	public:
+		Decode(const cfg_t* cfg) :
+			_cfg(cfg)
+		{
+			update_cfg();
+		}
+
+		// Converts the config values to the precision of the math (called when the config is changed, not per frame).
+		void update_cfg()
+		{
+			_decode_sharpening = T(_cfg->decode_sharpening);
+			_min_score = T(_cfg->min_score);
+			_prefilter_min_diff = T(_cfg->prefilter_min_diff);
+		}
+
+		~Decode()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_start_cv.notify_all();
+			for (auto& thread : _threads)
+				thread.join();
+		}
+
+		Decode(const Decode&) = delete;
+		Decode& operator=(const Decode&) = delete;
+
+		// frame - frame number of the trace events of the worker threads.
+		const std::vector<tag_t>& calc(const std::vector<basic_quad_t<T>>& quads, const image_t& gray_img, uint32_t frame = 0)
+		{
+			_tags.clear();
+			_stat = decode_stat_t();
+			_time = 0.0;
+			_time_dict = 0.0;
+			_perf = perf_t();
+			const uint32_t size = quads.size();
+			if (size == 0)
+				return _tags;
+			if (_cfg->tag_family.empty())
+				return _tags;
+			Stopwatch sw;
+			// Each worker gets a contiguous range of quads.
+			// The ranges are merged in order, so the result does not depend on the number of threads.
+			uint32_t nthreads = (size + _cfg->decode_min_quads - 1) / _cfg->decode_min_quads;
+			if (nthreads > _cfg->decode_threads)
+				nthreads = _cfg->decode_threads;
+			if (nthreads < 1)
+				nthreads = 1;
+			if (_ctx.size() < nthreads)
+				_ctx.resize(nthreads);
+			for (uint32_t t = 0; t < nthreads; ++t)
+			{
+				_ctx[t].init(_cfg->max_total_width);
+				_ctx[t].stat = decode_stat_t();
+				_ctx[t].time_dict = 0.0;
+			}
+			_tags.reserve(size);
+			if (nthreads == 1)
+			{
+				_decode(_ctx[0], quads, 0, size, gray_img, _tags);
+				_stat = _ctx[0].stat;
+				_time_dict = _ctx[0].time_dict;
+				sw.lap(_time, _perf);
+				return _tags;
+			}
+			// The threads are created once and then reused for all frames.
+			while (_threads.size() + 1 < nthreads)
+				_threads.emplace_back(&Decode::_worker, this, static_cast<uint32_t>(_threads.size() + 1), _job);
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_job_quads = &quads;
+				_job_img = &gray_img;
+				_job_frame = frame;
+				_job_threads = nthreads;
+				_running = nthreads - 1;
+				++_job;
+			}
+			_start_cv.notify_all();
+			_decode(_ctx[0], quads, 0, size / nthreads, gray_img, _tags);
+			_stat = _ctx[0].stat;
+			_time_dict = _ctx[0].time_dict;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_done_cv.wait(lock, [this]() { return _running == 0; });
+			}
+			for (uint32_t t = 1; t < nthreads; ++t)
+			{
+				_tags.insert(_tags.end(), _ctx[t].tags.begin(), _ctx[t].tags.end());
+				_stat += _ctx[t].stat;
+				_time_dict += _ctx[t].time_dict;
+			}
+			sw.lap(_time, _perf);
 			return _tags;
 		}
+
+		void timing(timing_t& t, perf_stat_t& p) const
+		{
+			t.decode = _time;
+			t.dict = _time_dict;
+			p.decode = _perf;
+		}
+
+		const decode_stat_t& stat() const
+		{
+			return _stat;
+		}
+
+		// Bytes held (including the contexts of the worker threads).
+		size_t memory() const
+		{
+			size_t size = _ctx.capacity() * sizeof(decode_ctx_t<T>) + _threads.capacity() * sizeof(std::thread)
+				+ _tags.capacity() * sizeof(tag_t);
+			for (const auto& ctx : _ctx)
+				size += (ctx.val.capacity() + ctx.tmp.capacity()) * sizeof(T) + ctx.tags.capacity() * sizeof(tag_t);
+			return size;
+		}
 	};
 }
\ No newline at end of file
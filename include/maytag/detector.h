@@ -1,36 +1,226 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 
 #include "cfg.h"
 #include "image.h"
 #include "decimate.h"
+#include "mask.h"
 #include "threshold.h"
 #include "contours.h"
 #include "quad.h"
 #include "decode.h"
+#include "dict_table.h"
+#include "dict_file.h"
 #include "dictionary.h"
+#include "dictionary_hash.h"
+#include "dictionary_mih.h"
+#include "dictionary_brute.h"
+#include "dictionary_async.h"
+#include "dict_registry.h"
+#include "timing.h"
+#include "histogram.h"
+#include "footprint.h"
+#include "trace.h"
 
 
 namespace maytag
 {
 	using namespace _;
 
-	class Detector
+	// T - precision of the decode and edge refinement math (double or float).
+	template <typename T>
+	class BasicDetector
 	{
 	private:
 		cfg_t _cfg;
 		Decimate _decimate;
+		Mask _mask;
+		Mask _collect_mask; // The mask of calc_quads (the parts of calc_quads can run in different threads).
 		Threshold _threshold;
 		Contours _contours;
-		Quad _quad;
-		Decode _decode;
+		Quad<T> _quad;
+		Decode<T> _decode;
 		bool _dict_stat = false;
+		dict_type_t _dict_type = dict_type_t::automatic;
+		bool _dict_async = false;
+		bool _dict_shared = true;
+		timing_t _timing;
+		perf_stat_t _perf;
+		latency_t _latency;
+		memory_t _memory_peak;
+		size_t _collect_mask_peak = 0;
+		contour_stat_t _contour_stat;
+		uint32_t _frame_labels = 0; // Frame numbers of the trace events.
+		uint32_t _frame_quads = 0;
+		uint32_t _frame_tags = 0;
+
+		static std::shared_ptr<Dictionary> _make_dict(const tag_family_t& tf, dict_type_t type, double dict_size_scale, bool dict_stat,
+			const std::atomic<bool>* cancel = nullptr)
+		{
+			if (type == dict_type_t::automatic)
+			{
+				const size_t ncodes = tf.ids.empty() ? tf.ncodes : tf.ids.size();
+				if (4 * ncodes <= DictionaryBrute::max_size)
+					type = dict_type_t::brute;
+				else if (tf.hamming > 3)
+					type = dict_type_t::mih;
+				else
+					type = dict_type_t::canonical;
+			}
+			if (type == dict_type_t::brute)
+				return std::make_shared<DictionaryBrute>(tf, dict_stat);
+			if (type == dict_type_t::mih || !DictionaryHash::supported(tf))
+				return std::make_shared<DictionaryMih>(tf, dict_stat);
+			return std::make_shared<DictionaryHash>(tf, dict_size_scale, dict_stat, type == dict_type_t::canonical, cancel);
+		}
+
+		// FNV-1a hash of the codes (families with the same name may have different codes).
+		static uint64_t _codes_hash(const tag_family_t& tf)
+		{
+			uint64_t hash = 14695981039346656037ull;
+			auto add = [&hash](uint64_t v)
+			{
+				for (uint32_t i = 0; i < 8; ++i)
+				{
+					hash ^= (v >> (8 * i)) & 0xFF;
+					hash *= 1099511628211ull;
+				}
+			};
+			add(tf.nbits);
+			add(tf.ncodes);
+			for (uint32_t i = 0; i < tf.ncodes; ++i)
+				add(tf.codes[i]);
+			return hash;
+		}
+
+		// Registry key: everything the dictionary depends on.
+		std::string _dict_key(const tag_family_t& tf, double dict_size_scale) const
+		{
+			std::string key = tf.name + "/" + std::to_string(_codes_hash(tf)) + "/" + std::to_string(tf.hamming) + "/" + std::to_string(static_cast<int>(_dict_type))
+				+ "/" + std::to_string(dict_size_scale) + (_dict_async ? "/async" : "");
+			if (!tf.ids.empty())
+			{
+				key += "/ids";
+				for (const uint16_t id : tf.ids)
+					key += "," + std::to_string(id);
+			}
+			return key;
+		}
+
+		std::shared_ptr<Dictionary> _create_dict(const tag_family_t& tf, double dict_size_scale, const dict_table_t* table) const
+		{
+			if (table && DictionaryHash::compatible(tf, *table))
+				return std::make_shared<DictionaryHash>(tf, *table, dict_size_scale, _dict_stat);
+			if (_dict_shared)
+			{
+				return DictRegistry::instance().get(_dict_key(tf, dict_size_scale),
+					[this, &tf, dict_size_scale]()
+					{
+						return _build_dict(tf, dict_size_scale);
+					});
+			}
+			return _build_dict(tf, dict_size_scale);
+		}
+
+		std::shared_ptr<Dictionary> _build_dict(const tag_family_t& tf, double dict_size_scale) const
+		{
+			if (_dict_async && tf.hamming > 0)
+			{
+				const dict_type_t type = _dict_type;
+				const bool dict_stat = _dict_stat;
+				return std::make_shared<DictionaryAsync>(tf,
+					[type, dict_size_scale, dict_stat](const tag_family_t& f, const std::atomic<bool>& cancel)
+					{
+						return _make_dict(f, type, dict_size_scale, dict_stat, &cancel);
+					},
+					_dict_stat);
+			}
+			return _make_dict(tf, _dict_type, dict_size_scale, _dict_stat);
+		}
+
+		// The family for the dictionary (with Chase decoding the dictionary corrects fewer bits).
+		tag_family_t _dict_family(const tag_family_t& tf) const
+		{
+			tag_family_t dict_tf = tf;
+			if (_cfg.chase_bits > 0 && dict_tf.hamming > _cfg.chase_dict_hamming)
+				dict_tf.hamming = _cfg.chase_dict_hamming;
+			return dict_tf;
+		}
+
+		// The stages keep the config values in the precision of their math.
+		void _update_cfg()
+		{
+			_quad.update_cfg();
+			_decode.update_cfg();
+		}
+
+		void _add_family(const tag_family_t& tf, double dict_size_scale, const dict_table_t* table)
+		{
+			if (tf.width_at_border < 2)
+				return;
+			if (tf.total_width < tf.width_at_border + 2)
+				return;
+			if (tf.total_width > _cfg.max_total_width)
+				_cfg.max_total_width = tf.total_width;
+			if (tf.black)
+				_cfg.border_mask |= 1;
+			else
+				_cfg.border_mask |= 2;
+			// Checking for duplicates.
+			uint32_t size = _cfg.tag_family.size();
+			for (uint32_t i = 0; i < size; ++i)
+			{
+				if (tf.name == _cfg.tag_family[i].name)
+				{
+					// Expand tag variability if needed.
+					if (_dict_shared)
+					{
+						// Shared dictionaries are not modified, the dictionary with the higher hamming is taken instead.
+						uint8_t hamming = 0;
+						for (const auto& family : _cfg.tag_family)
+						{
+							if (family.name == tf.name && family.hamming > hamming)
+								hamming = family.hamming;
+						}
+						if (tf.hamming > hamming)
+						{
+							tag_family_t dict_tf = tf;
+							dict_tf.ids = _cfg.tag_family[i].ids;
+							auto dict = _create_dict(_dict_family(dict_tf), dict_size_scale, nullptr);
+							for (uint32_t j = 0; j < size; ++j)
+							{
+								if (_cfg.tag_family[j].name == tf.name)
+									_cfg.tag_dict[j] = dict;
+							}
+						}
+					}
+					else
+						_cfg.tag_dict[i]->update_hamming(_dict_family(tf), dict_size_scale, _dict_stat);
+					// We use the same dictionaries.
+					if (tf.black != _cfg.tag_family[i].black)
+					{
+						_cfg.tag_family.emplace_back(tf);
+						_cfg.tag_dict.emplace_back(_cfg.tag_dict[i]);
+					}
+					else
+						_cfg.tag_family[i].hamming = tf.hamming;
+					return;
+				}
+			}
+			_cfg.tag_family.emplace_back(tf);
+			_cfg.tag_dict.emplace_back(_create_dict(_dict_family(tf), dict_size_scale, table));
+		}
 
 	public:
-		Detector():
+		BasicDetector():
 			_decimate(&_cfg),
+			_mask(&_cfg),
+			_collect_mask(&_cfg),
 			_threshold(&_cfg),
 			_contours(&_cfg),
 			_quad(&_cfg),
@@ -40,11 +230,215 @@ namespace maytag
 
 		const std::vector<tag_t>& calc(const image_t& gray_img)
 		{
+			const auto& quads = calc_quads(gray_img);
+			const auto& tags = calc_tags(quads, gray_img);
+#if defined(MAYTAG_TIMING)
+			_latency.total.add(_timing.total());
+#endif
+			return tags;
+		}
+
+		// The first part of calc (decimate, threshold, contours and quads).
+		// calc_quads and calc_tags use different buffers, so they can run in different threads.
+		const std::vector<basic_quad_t<T>>& calc_quads(const image_t& gray_img)
+		{
+			const image_t thresh_img = calc_labels(gray_img, _contours);
+			return calc_quads(gray_img, thresh_img, _contours);
+		}
+
+		// Contours for calc_labels and calc_quads (one per frame in flight, see Pipeline).
+		std::unique_ptr<Contours> make_contours() const
+		{
+			return std::unique_ptr<Contours>(new Contours(&_cfg));
+		}
+
+		// The first half of calc_quads (decimate, threshold and contour labels), the labels are kept in contours.
+		// Returns the threshold image (valid until the next call).
+		// calc_labels and the other calc_quads use different buffers, so they can run in different threads (see Pipeline).
+		image_t calc_labels(const image_t& gray_img, Contours& contours)
+		{
+			_timing.decimate = 0.0;
+			_timing.threshold = 0.0;
+			_perf.decimate = perf_t();
+			_perf.threshold = perf_t();
+			const uint32_t frame = ++_frame_labels;
+			Stopwatch sw;
+			trace_begin("decimate", frame);
 			image_t decimate_img = _decimate.calc(gray_img);
-			image_t thresh_img = _threshold.calc(decimate_img);
-			auto& contours = _contours.calc(thresh_img);
-			const auto& quads = _quad.calc(contours, gray_img);
-			return _decode.calc(quads, gray_img);
+			trace_end("decimate", frame);
+			sw.lap(_timing.decimate, _perf.decimate);
+			const Mask* mask = _mask.calc(gray_img, decimate_img) ? &_mask : nullptr;
+			trace_begin("threshold", frame);
+			image_t thresh_img = _threshold.calc(decimate_img, mask);
+			trace_end("threshold", frame);
+			sw.lap(_timing.threshold, _perf.threshold);
+			trace_begin("contour label", frame);
+			contours.label(thresh_img, mask);
+			trace_end("contour label", frame);
+			contours.timing_label(_timing, _perf);
+#if defined(MAYTAG_TIMING)
+			_latency.decimate.add(_timing.decimate);
+			_latency.threshold.add(_timing.threshold);
+			_latency.contour_label.add(_timing.contour_label);
+#endif
+			_memory_peak.decimate = std::max(_memory_peak.decimate, _decimate.memory());
+			_memory_peak.mask = std::max(_memory_peak.mask, _mask.memory());
+			_memory_peak.threshold = std::max(_memory_peak.threshold, _threshold.memory());
+			return thresh_img;
+		}
+
+		// The second half of calc_quads (contour points and quads) with the labels of calc_labels.
+		// thresh_img - the image returned by calc_labels (or its copy).
+		const std::vector<basic_quad_t<T>>& calc_quads(const image_t& gray_img, const image_t& thresh_img, Contours& contours)
+		{
+			const uint32_t frame = ++_frame_quads;
+			const Mask* mask = _collect_mask.calc(gray_img, thresh_img) ? &_collect_mask : nullptr;
+			trace_begin("contour collect", frame);
+			auto& points = contours.collect(thresh_img, mask);
+			trace_end("contour collect", frame);
+			trace_begin("quads", frame);
+			const auto& quads = _quad.calc(points, gray_img, mask);
+			trace_end("quads", frame);
+			_contour_stat = contours.stat();
+			contours.timing_collect(_timing, _perf);
+			_quad.timing(_timing, _perf);
+#if defined(MAYTAG_TIMING)
+			_latency.contour_collect.add(_timing.contour_collect);
+			_latency.quad_sort.add(_timing.quad_sort);
+			_latency.quad_fit.add(_timing.quad_fit);
+			_latency.quad_refine.add(_timing.quad_refine);
+#endif
+			_collect_mask_peak = std::max(_collect_mask_peak, _collect_mask.memory());
+			_memory_peak.contours = std::max(_memory_peak.contours, contours.memory());
+			_memory_peak.quad = std::max(_memory_peak.quad, _quad.memory());
+			return quads;
+		}
+
+		// The second part of calc (decoding).
+		// The frame number of the trace events counts the calls, so calc_tags must be called for each calc_quads.
+		const std::vector<tag_t>& calc_tags(const std::vector<basic_quad_t<T>>& quads, const image_t& gray_img)
+		{
+			const uint32_t frame = ++_frame_tags;
+			trace_begin("decode", frame);
+			const auto& tags = _decode.calc(quads, gray_img, frame);
+			trace_end("decode", frame);
+			_decode.timing(_timing, _perf);
+#if defined(MAYTAG_TIMING)
+			_latency.decode.add(_timing.decode);
+			_latency.dict.add(_timing.dict);
+#endif
+			_memory_peak.decode = std::max(_memory_peak.decode, _decode.memory());
+			return tags;
+		}
+
+		// Stage times of the last frame (only with MAYTAG_TIMING defined).
+		const timing_t& timing() const
+		{
+			return _timing;
+		}
+
+		// Stage hardware counters of the last frame (only with MAYTAG_PERF defined on Linux).
+		const perf_stat_t& perf() const
+		{
+			return _perf;
+		}
+
+		// Stage time histograms since the creation or reset_latency (only with MAYTAG_TIMING defined).
+		// total is filled by calc, with Pipeline the stages are filled by its threads (read when no frames are pending).
+		const latency_t& latency() const
+		{
+			return _latency;
+		}
+
+		// Starts a new window of the latency histograms.
+		void reset_latency()
+		{
+			_latency.reset();
+		}
+
+		// Bytes held by the stages and the dictionaries now.
+		// With Pipeline call it when no frames are pending.
+		memory_t memory() const
+		{
+			memory_t m;
+			m.decimate = _decimate.memory();
+			m.mask = _mask.memory() + _collect_mask.memory();
+			m.threshold = _threshold.memory();
+			m.contours = _contours.memory();
+			m.quad = _quad.memory();
+			m.decode = _decode.memory();
+			for (const auto& d : dict_memory())
+				m.dict += d.bytes;
+			return m;
+		}
+
+		// Maximum bytes of each stage at the end of calc (total() is an upper bound of the peak), dict is the current size.
+		memory_t memory_peak() const
+		{
+			memory_t m = _memory_peak;
+			m.mask += _collect_mask_peak;
+			m.dict = memory().dict;
+			return m;
+		}
+
+		// Dictionaries of the families (a dictionary used by several families is listed once).
+		std::vector<dict_memory_t> dict_memory() const
+		{
+			std::vector<dict_memory_t> dicts;
+			const size_t size = _cfg.tag_dict.size();
+			for (size_t i = 0; i < size; ++i)
+			{
+				const auto& dict = _cfg.tag_dict[i];
+				if (std::find(_cfg.tag_dict.begin(), _cfg.tag_dict.begin() + i, dict) != _cfg.tag_dict.begin() + i)
+					continue;
+				const long refs = static_cast<long>(std::count(_cfg.tag_dict.begin(), _cfg.tag_dict.end(), dict));
+				dict_memory_t d;
+				d.name = _cfg.tag_family[i].name;
+				d.hamming = _cfg.tag_family[i].hamming;
+				d.bytes = dict->memory();
+				d.shared = dict.use_count() > refs;
+				dicts.push_back(d);
+			}
+			return dicts;
+		}
+
+		// The hardware counters can be read in this thread (perf_event_open is allowed and supported).
+		static bool perf_available()
+		{
+			return PerfGroup::thread().available();
+		}
+
+		// Detection only inside the rectangles (in the input image pixels). Empty - the whole image.
+		// The work of the threshold and contours stages is proportional to the active area.
+		void set_roi(const std::vector<roi_t>& roi)
+		{
+			_cfg.roi = roi;
+			++_cfg.mask_version;
+		}
+
+		// Static mask: mask_w x mask_h cells over the input image (any resolution, e.g. the tile grid), 0 - skipped.
+		// It is combined with the rectangles of set_roi. Empty - no mask.
+		void set_mask(const std::vector<uint8_t>& mask, uint32_t mask_w, uint32_t mask_h)
+		{
+			if (mask.size() != static_cast<size_t>(mask_w) * mask_h)
+				return;
+			_cfg.mask = mask;
+			_cfg.mask_w = mask_w;
+			_cfg.mask_h = mask_h;
+			++_cfg.mask_version;
+		}
+
+		const std::vector<roi_t>& roi() const
+		{
+			return _cfg.roi;
+		}
+
+		// The mask of set_mask (mask_w x mask_h cells).
+		const std::vector<uint8_t>& mask(uint32_t& mask_w, uint32_t& mask_h) const
+		{
+			mask_w = _cfg.mask_w;
+			mask_h = _cfg.mask_h;
+			return _cfg.mask;
 		}
 
 		// quad_decimate = 1, 1.5, 2, 3, ...
@@ -68,6 +462,7 @@ namespace maytag
 				_cfg.quad_decimate_type = 0;
 				_cfg.quad_decimate = 1.5;
 			}
+			_update_cfg();
 		}
 
 		//
@@ -101,6 +496,7 @@ namespace maytag
 				_cfg.center_eps = 0.5;
 			else
 				_cfg.center_eps = center_eps;
+			_update_cfg();
 		}
 
 		//
@@ -110,24 +506,28 @@ namespace maytag
 				_cfg.min_tag_size = 5.0;
 			else
 				_cfg.min_tag_size = min_tag_size;
+			_update_cfg();
 		}
 
 		//
 		void set_min_tag_area(double min_tag_area)
 		{
 			_cfg.min_tag_area = min_tag_area;
+			_update_cfg();
 		}
 
 		//
 		void set_max_line_fit_mse(double max_line_fit_mse)
 		{
 			_cfg.max_line_fit_mse = max_line_fit_mse;
+			_update_cfg();
 		}
 
 		//
 		void set_max_cos(double max_cos)
 		{
 			_cfg.max_cos = max_cos;
+			_update_cfg();
 		}
 
 		//
@@ -142,18 +542,21 @@ namespace maytag
 			if (grange > 1.0)
 				grange = 1.0;
 			_cfg.grange = grange;
+			_update_cfg();
 		}
 
 		//
 		void set_decode_sharpening(double decode_sharpening)
 		{
 			_cfg.decode_sharpening = decode_sharpening;
+			_update_cfg();
 		}
 
 		//
 		void set_min_score(double min_score)
 		{
 			_cfg.min_score = min_score;
+			_update_cfg();
 		}
 
 		//
@@ -162,47 +565,151 @@ namespace maytag
 			_cfg.interpolate = interpolate;
 		}
 
+		// Cheap rejection of quads before decoding.
+		// min_diff - minimum average difference between the white and black cells along the border.
+		void set_prefilter(bool prefilter, double min_diff = 10.0)
+		{
+			_cfg.prefilter = prefilter;
+			_cfg.prefilter_min_diff = min_diff;
+			_update_cfg();
+		}
+
+		// Number of threads used to decode quads (1 - single-threaded).
+		// The order of the found tags does not depend on the number of threads.
+		void set_decode_threads(uint32_t decode_threads, uint32_t decode_min_quads = 16)
+		{
+			if (decode_threads < 1)
+				decode_threads = 1;
+			if (decode_min_quads < 1)
+				decode_min_quads = 1;
+			_cfg.decode_threads = decode_threads;
+			_cfg.decode_min_quads = decode_min_quads;
+		}
+
+		// Soft decision (Chase) decoding.
+		// If the code is not found, all combinations of the bits least reliable bits are flipped (bits <= 8, 0 - disabled).
+		// dict_hamming - the dictionaries of the next add_family are built for this hamming distance only,
+		// the family hamming is reached by the flips (tags with errors in reliable bits are not corrected).
+		// For example, tag36h11 with hamming 3, bits = 6 and dict_hamming = 1 uses a 0.5 MB dictionary instead of 134 MB.
+		void set_chase(uint8_t bits, uint8_t dict_hamming = 1)
+		{
+			if (bits > 8)
+				bits = 8;
+			_cfg.chase_bits = bits;
+			_cfg.chase_dict_hamming = dict_hamming;
+		}
+
+		// Contour counters of the last frame.
+		const contour_stat_t& contour_stat() const
+		{
+			return _contour_stat;
+		}
+
+		// Quad counters of the last frame (the rejected contours by the reason).
+		const quad_stat_t& quad_stat() const
+		{
+			return _quad.stat();
+		}
+
+		// Decode counters of the last frame.
+		const decode_stat_t& decode_stat() const
+		{
+			return _decode.stat();
+		}
+
 		void set_dict_stat(bool dict_stat)
 		{
 			_dict_stat = dict_stat;
 		}
 
+		// Type of the dictionary for the next add_family (see dict_type_t).
+		// mih - multi-index hashing: small memory and the hamming distance above 3 (up to nbits / 4 - 1).
+		// brute - all rotated codes are compared (fits in a few cache lines for small families like tag16h5).
+		// canonical - hash table keyed by the minimum rotation: one probe sequence per decode instead of four, the build is about 1.3 times slower.
+		// automatic (default) - brute if 4 * ncodes <= 256, mih if hamming > 3, otherwise canonical.
+		void set_dict_type(dict_type_t dict_type)
+		{
+			_dict_type = dict_type;
+		}
+
+		// Share the dictionaries between all detectors of the process (for the next add_family, default true).
+		// Detectors with the same family, hamming, dictionary type, size scale and ids use one dictionary.
+		void set_dict_shared(bool dict_shared)
+		{
+			_dict_shared = dict_shared;
+		}
+
+		// Build the dictionaries in the background (for the next add_family).
+		// The hamming 0 dictionary is built in add_family, higher levels are swapped in when ready.
+		// Tags with more errors are not found until the level is ready.
+		void set_dict_async(bool dict_async)
+		{
+			_dict_async = dict_async;
+		}
+
 		// dict_size_scale - specifies the size of the dictionary.
 		// The larger the value, the larger the size but the faster the search.
 		// For the change to take effect, you must install before call add_family.
 		void add_family(const tag_family_t& tf, double dict_size_scale = 3.0)
 		{
-			if (tf.width_at_border < 2)
-				return;
-			if (tf.total_width < tf.width_at_border + 2)
+			_add_family(tf, dict_size_scale, nullptr);
+		}
+
+		// Add the family with the subset of the codes (tag_family_t::ids).
+		// The dictionary and the error correction cover only these ids: less memory and fewer false positives.
+		// The ids of the first add_family of the family are used (the dictionary is shared).
+		void add_family(const tag_family_t& tf, const std::vector<uint16_t>& ids, double dict_size_scale = 3.0)
+		{
+			tag_family_t tf_ids = tf;
+			tf_ids.ids = ids;
+			_add_family(tf_ids, dict_size_scale, nullptr);
+		}
+
+		// Add the family with the prebuilt hash table (see example/dictionary).
+		// The table is used without copying, it must outlive the detector.
+		// If the table does not match the family (name, version, hamming), the dictionary is built as usual.
+		void add_family(const tag_family_t& tf, const dict_table_t& table, double dict_size_scale = 3.0)
+		{
+			_add_family(tf, dict_size_scale, &table);
+		}
+
+		// Add the family with the hash table cached in the file (see load_dict_table).
+		// The file is mapped, so all processes with the same file share one copy of the table.
+		// If the file is missing, does not match the family (or its hamming) or is corrupted, the table is built and saved to the file.
+		// The table is canonical unless set_dict_type(dict_type_t::hash), other dictionary types are not cached.
+		void add_family_cache(const tag_family_t& tf, const std::string& path, double dict_size_scale = 3.0)
+		{
+			// Subsets are small, they are not cached.
+			if (!tf.ids.empty())
+			{
+				_add_family(tf, dict_size_scale, nullptr);
 				return;
-			if (tf.total_width > _cfg.max_total_width)
-				_cfg.max_total_width = tf.total_width;
-			if (tf.black)
-				_cfg.border_mask |= 1;
-			else
-				_cfg.border_mask |= 2;
-			// Checking for duplicates.
-			uint32_t size = _cfg.tag_family.size();
-			for (uint32_t i = 0; i < size; ++i)
+			}
+			const tag_family_t dict_tf = _dict_family(tf);
+			dict_table_t table = load_dict_table(path);
+			if (!DictionaryHash::valid(dict_tf, table) && DictionaryHash::supported(dict_tf))
 			{
-				if (tf.name == _cfg.tag_family[i].name)
-				{
-					// Expand tag variability if needed.
-					_cfg.tag_dict[i]->update_hamming(tf, dict_size_scale, _dict_stat);
-					// We use the same dictionaries.
-					if (tf.black != _cfg.tag_family[i].black)
-					{
-						_cfg.tag_family.emplace_back(tf);
-						_cfg.tag_dict.emplace_back(_cfg.tag_dict[i]);
-					}
-					else
-						_cfg.tag_family[i].hamming = tf.hamming;
-					return;
-				}
+				// If the file can not be written, the built table is used directly.
+				auto dict = std::make_shared<DictionaryHash>(dict_tf, dict_size_scale, _dict_stat, _dict_type != dict_type_t::hash);
+				table = dict->table(tf.name);
+				table.owner = dict;
+				if (save_dict_table(table, path))
+					table = load_dict_table(path);
 			}
-			_cfg.tag_family.emplace_back(tf);
-			_cfg.tag_dict.emplace_back(std::make_shared<Dictionary>(tf, dict_size_scale, _dict_stat));
+			_add_family(tf, dict_size_scale, &table);
+		}
+
+		// Tag family by index (tag_t::family).
+		// The index is valid until clear_family is called.
+		const tag_family_t& family(uint16_t idx) const
+		{
+			return _cfg.tag_family[idx];
+		}
+
+		// Tag family name of the found tag.
+		const std::string& family_name(const tag_t& tag) const
+		{
+			return _cfg.tag_family[tag.family].name;
 		}
 
 		//
@@ -214,4 +721,10 @@ namespace maytag
 			_cfg.tag_dict.clear();
 		}
 	};
+
+	using Detector = BasicDetector<double>;
+	// Single precision decode and edge refinement.
+	using DetectorF = BasicDetector<float>;
+	// Fixed-point math for targets without FPU (see fixed.h).
+	using DetectorFixed = BasicDetector<fixed_t>;
 }
\ No newline at end of file
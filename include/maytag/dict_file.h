@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAYTAG_DICT_MMAP
+#endif
+
+#include "dict_table.h"
+#include "dictionary_hash.h"
+
+
+namespace maytag
+{
+	// Binary file of the hash dictionary table.
+	// The header is 64 B, so the entries stay 64 B aligned in the mapped file.
+	// The file is read with mmap (POSIX): all processes share one page-cached copy.
+	namespace _
+	{
+		struct dict_file_header_t
+		{
+			char magic[8];       // "MAYTAGD".
+			uint32_t endian;     // 0x01020304 (the file is not portable between byte orders).
+			uint32_t version;    // DictionaryHash::table_version.
+			uint32_t ncodes;
+			uint32_t nbits;
+			uint32_t hamming;
+			uint32_t size;       // Number of entries.
+			uint32_t max_search;
+			uint32_t flags;      // 1 - canonical.
+			char name[24];       // Tag family name (zero terminated).
+		};
+
+		static_assert(sizeof(dict_file_header_t) == 64, "dict_file_header_t must be 64 bytes");
+
+		constexpr char dict_file_magic[8] = "MAYTAGD";
+		constexpr uint32_t dict_file_endian = 0x01020304;
+
+		inline bool dict_file_check(const dict_file_header_t& h, size_t file_size)
+		{
+			if (std::memcmp(h.magic, dict_file_magic, sizeof(h.magic)) != 0)
+				return false;
+			if (h.endian != dict_file_endian || h.version != DictionaryHash::table_version)
+				return false;
+			if (h.name[sizeof(h.name) - 1] != 0)
+				return false;
+			return file_size == sizeof(dict_file_header_t) + static_cast<size_t>(h.size) * sizeof(uint64_t);
+		}
+
+		inline dict_table_t dict_file_table(const dict_file_header_t& h, const uint64_t* data, std::shared_ptr<const void> owner)
+		{
+			dict_table_t t;
+			t.name = h.name;
+			t.version = h.version;
+			t.ncodes = h.ncodes;
+			t.nbits = h.nbits;
+			t.hamming = static_cast<uint8_t>(h.hamming);
+			t.size = h.size;
+			t.max_search = h.max_search;
+			t.canonical = (h.flags & 1) != 0;
+			t.table = data;
+			t.owner = std::move(owner);
+			return t;
+		}
+	}
+
+	// Save the table to the file.
+	// The file is written to a temporary file and renamed, so other processes never see a partial file.
+	inline bool save_dict_table(const dict_table_t& table, const std::string& path)
+	{
+		if (!table.table || table.name.size() >= sizeof(_::dict_file_header_t::name))
+			return false;
+		_::dict_file_header_t h;
+		std::memset(&h, 0, sizeof(h));
+		std::memcpy(h.magic, _::dict_file_magic, sizeof(h.magic));
+		h.endian = _::dict_file_endian;
+		h.version = table.version;
+		h.ncodes = table.ncodes;
+		h.nbits = table.nbits;
+		h.hamming = table.hamming;
+		h.size = table.size;
+		h.max_search = table.max_search;
+		h.flags = table.canonical ? 1 : 0;
+		std::memcpy(h.name, table.name.c_str(), table.name.size());
+#if defined(MAYTAG_DICT_MMAP)
+		const std::string tmp = path + ".tmp" + std::to_string(getpid());
+#else
+		const std::string tmp = path + ".tmp";
+#endif
+		FILE* f = std::fopen(tmp.c_str(), "wb");
+		if (!f)
+			return false;
+		bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+		ok = ok && std::fwrite(table.table, sizeof(uint64_t), table.size, f) == table.size;
+		ok = (std::fclose(f) == 0) && ok;
+		if (ok)
+			ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+		if (!ok)
+			std::remove(tmp.c_str());
+		return ok;
+	}
+
+	// Load the table from the file (table == nullptr on error).
+	// The mapping is kept by dict_table_t::owner and released with the last dictionary using it.
+	inline dict_table_t load_dict_table(const std::string& path)
+	{
+		_::dict_file_header_t h;
+#if defined(MAYTAG_DICT_MMAP)
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return dict_table_t();
+		struct stat st;
+		if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(h))
+		{
+			close(fd);
+			return dict_table_t();
+		}
+		const size_t file_size = static_cast<size_t>(st.st_size);
+		void* addr = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (addr == MAP_FAILED)
+			return dict_table_t();
+		std::shared_ptr<const void> owner(addr, [file_size](const void* p) { munmap(const_cast<void*>(p), file_size); });
+		std::memcpy(&h, addr, sizeof(h));
+		if (!_::dict_file_check(h, file_size))
+			return dict_table_t();
+		const uint64_t* data = reinterpret_cast<const uint64_t*>(static_cast<const char*>(addr) + sizeof(h));
+		return _::dict_file_table(h, data, std::move(owner));
+#else
+		// Without mmap the table is read to the memory (64 B aligned).
+		FILE* f = std::fopen(path.c_str(), "rb");
+		if (!f)
+			return dict_table_t();
+		std::fseek(f, 0, SEEK_END);
+		const long file_size = std::ftell(f);
+		std::fseek(f, 0, SEEK_SET);
+		if (file_size < static_cast<long>(sizeof(h)) || std::fread(&h, sizeof(h), 1, f) != 1
+			|| !_::dict_file_check(h, static_cast<size_t>(file_size)))
+		{
+			std::fclose(f);
+			return dict_table_t();
+		}
+		auto buf = std::make_shared<std::vector<uint64_t>>(h.size + 8);
+		uint64_t* data = buf->data();
+		while (reinterpret_cast<uintptr_t>(data) % 64 != 0)
+			++data;
+		const bool ok = std::fread(data, sizeof(uint64_t), h.size, f) == h.size;
+		std::fclose(f);
+		if (!ok)
+			return dict_table_t();
+		return _::dict_file_table(h, data, std::move(buf));
+#endif
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "dictionary.h"
+
+
+namespace maytag::_
+{
+	// Process-wide registry of the dictionaries.
+	// Detectors with the same dictionary settings share one instance (decode is const and thread-safe).
+	// The registry keeps weak references: the dictionary is released with the last detector using it.
+	class DictRegistry
+	{
+	private:
+		using future_t = std::shared_future<std::shared_ptr<Dictionary>>;
+
+		struct entry_t
+		{
+			std::weak_ptr<Dictionary> dict;
+			future_t build; // Valid while the dictionary is being built.
+		};
+
+		std::mutex _mutex;
+		std::map<std::string, entry_t> _dicts;
+
+		DictRegistry() = default;
+
+	public:
+		DictRegistry(const DictRegistry&) = delete;
+		DictRegistry& operator=(const DictRegistry&) = delete;
+
+		static DictRegistry& instance()
+		{
+			static DictRegistry registry;
+			return registry;
+		}
+
+		// The dictionary with the key, create is called if there is none.
+		// The build is done outside the lock: concurrent requests for the same key wait for it,
+		// requests for other keys are not blocked. If create throws, the waiting requests get the exception.
+		std::shared_ptr<Dictionary> get(const std::string& key, const std::function<std::shared_ptr<Dictionary> ()>& create)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			for (auto it = _dicts.begin(); it != _dicts.end();)
+			{
+				if (it->second.dict.expired() && !it->second.build.valid())
+					it = _dicts.erase(it);
+				else
+					++it;
+			}
+			entry_t& entry = _dicts[key]; // Not erased while it is being built.
+			std::shared_ptr<Dictionary> dict = entry.dict.lock();
+			if (dict)
+				return dict;
+			if (entry.build.valid())
+			{
+				const future_t build = entry.build;
+				lock.unlock();
+				return build.get();
+			}
+			std::promise<std::shared_ptr<Dictionary>> promise;
+			entry.build = promise.get_future().share();
+			lock.unlock();
+			try
+			{
+				dict = create();
+			}
+			catch (...)
+			{
+				lock.lock();
+				entry.build = future_t();
+				lock.unlock();
+				promise.set_exception(std::current_exception());
+				throw;
+			}
+			lock.lock();
+			entry.dict = dict;
+			entry.build = future_t();
+			lock.unlock();
+			promise.set_value(dict);
+			return dict;
+		}
+
+		// Number of the dictionaries in use.
+		size_t size()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			size_t n = 0;
+			for (const auto& it : _dicts)
+			{
+				if (!it.second.dict.expired())
+					++n;
+			}
+			return n;
+		}
+	};
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+
+namespace maytag
+{
+	// Prebuilt table of the hash dictionary (generated by example/dictionary or loaded by load_dict_table).
+	// The table is a static const array, so it is placed in read-only memory and shared between processes.
+	struct dict_table_t
+	{
+		std::string name;                // Tag family name.
+		uint32_t version = 0;            // Table layout version (must match DictionaryHash::table_version).
+		uint32_t ncodes = 0;             // Number of codes in the family.
+		uint32_t nbits = 0;              // Number of bits in the code.
+		uint8_t hamming = 0;             // How many errors corrected?
+		uint32_t size = 0;               // Number of entries (power of two).
+		uint32_t max_search = 0;         // Maximum number of groups to check.
+		bool canonical = false;          // The key is the minimum of the code rotations.
+		const uint64_t* table = nullptr; // Entries (64 B aligned).
+		std::shared_ptr<const void> owner; // Keeps the memory of the table (file mapping), empty for static tables.
+	};
+}
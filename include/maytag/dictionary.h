@@ -1,194 +1,131 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
-#include <limits>
+#include <vector>
 
 #include "tag_family.h"
-#include "tag.h"
 
 
 namespace maytag::_
 {
-	class Dictionary
+	// Dictionary types.
+	enum class dict_type_t : uint8_t
 	{
-	private:
-		struct quick_decode_t
-		{
-			uint64_t code = std::numeric_limits<uint64_t>::max(); // The queried code.
-			uint16_t id;     // The tag ID (a small integer).
-			uint8_t hamming; // How many errors corrected?
-		};
+		automatic, // brute for small families, mih for hamming > 3, otherwise canonical.
+		hash,      // Hash table with all codes within the hamming distance (fast, large, hamming <= 3).
+		mih,       // Multi-index hashing (small, any hamming).
+		brute,     // Brute force search (small families, any hamming).
+		canonical  // Hash table keyed by the minimum of the code rotations (one probe sequence per decode, slower build).
+	};
 
+	// Search for the nearest code of the tag family (with error correction).
+	class Dictionary
+	{
+	protected:
 		const uint32_t _nbits;
-		const uint32_t _ncodes;
+		const std::vector<uint16_t> _ids; // Ids of the codes in the dictionary (all codes or family.ids).
+		const uint32_t _ncodes;           // Number of the codes in the dictionary.
 		const uint64_t* const _codes;
-		const uint64_t _mask; 
-		quick_decode_t* _dictionary = nullptr;
-		uint32_t _size = 0;
+		const uint64_t _mask;
 		uint8_t _max_hamming = 255;
-		uint32_t _max_search = 0;
-
-		inline uint32_t _hash(uint64_t code) const
-		{
-			return (code * 131) % _size;
-		}
-
-		void _add(uint64_t code, uint16_t id, uint8_t hamming)
-		{
-			uint32_t n = 1;
-			uint32_t hash = _hash(code);
-			while (_dictionary[hash].code != std::numeric_limits<uint64_t>::max())
-			{
-				hash = (hash + 1) % _size;
-				++n;
-			}
-			if (n > _max_search)
-				_max_search = n;
-			_dictionary[hash].code = code;
-			_dictionary[hash].id = id;
-			_dictionary[hash].hamming = hamming;
-		}
 
 		// Assuming we are drawing the image one quadrant at a time, what would the rotated image look like?
 		// Special care is taken to handle the case where there is a middle pixel of the image.
-		uint64_t _rotate90(uint64_t w) const
+		static inline uint64_t _rotate90(uint64_t w, uint32_t nbits, uint64_t mask)
 		{
-			if (_nbits % 4 == 1)
+			if (nbits % 4 == 1)
 			{
-				const uint32_t p = (_nbits - 1) >> 2;
+				const uint32_t p = (nbits - 1) >> 2;
 				w = ((w >> 1) << (p + 1)) | ((w >> (3 * p + 1)) << 1) | (w & 1);
 			}
 			else
 			{
-				const uint32_t p = _nbits >> 2;
+				const uint32_t p = nbits >> 2;
 				w = (w << p) | (w >> (3 * p));
 			}
-			return w & _mask;
+			return w & mask;
 		}
 
-		//
-		bool _create(uint8_t hamming, double size_scale)
+		uint64_t _rotate90(uint64_t w) const
 		{
-			if (hamming > 3)
-				hamming = 3;
-			if (hamming <= _max_hamming && _max_hamming != 255)
-				return false;
-			_max_hamming = hamming;
-			uint32_t capacity = _ncodes;
-			if (_max_hamming >= 1)
-				capacity += _ncodes * _nbits;
-			if (_max_hamming >= 2)
-				capacity += _ncodes * _nbits * (_nbits - 1) / 2;
-			if (_max_hamming >= 3)
-				capacity += _ncodes * _nbits * (_nbits - 1) * (_nbits - 2) / 6;
-			_size = static_cast<uint32_t>(capacity * size_scale);
-			if (_size < capacity)
-				_size = capacity;
-			if (_dictionary)
-				delete[] _dictionary;
-			_dictionary = new quick_decode_t[_size];
-			_max_search = 0;
-			//
-			const uint64_t one = 1;
-			for (uint32_t i = 0; i < _ncodes; ++i)
-			{
-				const uint64_t code = _codes[i];
-				_add(code, i, 0);
-			}
-			if (_max_hamming >= 1)
-			{
-				for (uint32_t i = 0; i < _ncodes; ++i)
-				{
-					const uint64_t code = _codes[i];
-					for (uint32_t j = 0; j < _nbits; ++j)
-						_add(code ^ (one << j), i, 1);
-				}
-			}
-			if (_max_hamming >= 2)
+			return _rotate90(w, _nbits, _mask);
+		}
+
+		// Sorted unique ids (invalid ids are skipped).
+		static std::vector<uint16_t> _make_ids(const tag_family_t& family)
+		{
+			std::vector<uint16_t> ids;
+			if (family.ids.empty())
 			{
-				for (uint32_t i = 0; i < _ncodes; ++i)
-				{
-					const uint64_t code = _codes[i];
-					for (uint32_t j = 0; j < _nbits; ++j)
-					{
-						for (uint32_t k = 0; k < j; ++k)
-							_add(code ^ (one << j) ^ (one << k), i, 2);
-					}
-				}
+				ids.resize(family.ncodes);
+				for (uint32_t i = 0; i < family.ncodes; ++i)
+					ids[i] = static_cast<uint16_t>(i);
+				return ids;
 			}
-			if (_max_hamming >= 3)
+			for (const uint16_t id : family.ids)
 			{
-				for (uint32_t i = 0; i < _ncodes; ++i)
-				{
-					const uint64_t code = _codes[i];
-					for (uint32_t j = 0; j < _nbits; ++j)
-					{
-						for (uint32_t k = 0; k < j; ++k)
-						{
-							for (uint32_t m = 0; m < k; ++m)
-								_add(code ^ (one << j) ^ (one << k) ^ (one << m), i, 3);
-						}
-					}
-				}
+				if (id < family.ncodes)
+					ids.push_back(id);
 			}
-			return true;
+			std::sort(ids.begin(), ids.end());
+			ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+			return ids;
 		}
 
-		void _print_stat(const std::string& name, const std::string& text, double size_scale) const
+		static inline uint32_t _popcount(uint64_t v)
 		{
-			std::cout << "MayTag dictionary " << text << "\n"
-				<< "\tname: " << name << "\n"
-				<< "\tncodes: " << _ncodes << "\n"
-				<< "\thamming: " << static_cast<int>(_max_hamming) << "\n"
-				<< "\tmax_search: " << _max_search << "\n"
-				<< "\tsize_scale: " << size_scale << "\n"
-				<< "\tsize: " << _size * sizeof(quick_decode_t) << " B" << std::endl;
+#if defined(__GNUC__)
+			return __builtin_popcountll(v);
+#else
+			v = v - ((v >> 1) & 0x5555555555555555ULL);
+			v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+			v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+			return static_cast<uint32_t>((v * 0x0101010101010101ULL) >> 56);
+#endif
 		}
 
 	public:
-		Dictionary(const tag_family_t& family, double size_scale = 3.0, bool stat = false):
+		Dictionary(const tag_family_t& family):
 			_nbits(family.nbits),
-			_ncodes(family.ncodes),
+			_ids(_make_ids(family)),
+			_ncodes(static_cast<uint32_t>(_ids.size())),
 			_codes(family.codes),
 			_mask(((uint64_t)1 << family.nbits) - 1)
 		{
-			if (_create(family.hamming, size_scale) && stat)
-				_print_stat(family.name, "created", size_scale);
 		}
 
-		~Dictionary()
+		virtual ~Dictionary() = default;
+
+		// Expand the error correction up to family.hamming.
+		virtual void update_hamming(const tag_family_t& family, double size_scale = 3.0, bool stat = false) = 0;
+
+		// code - code of the quad.
+		// id - tag id.
+		// hamming - number of corrected bits.
+		// rot - number of 90 degree rotations of the code.
+		virtual bool decode(uint64_t code, uint16_t& id, uint8_t& hamming, uint8_t& rot) const = 0;
+
+		// Bytes held by the dictionary (prebuilt and mapped tables are not included).
+		virtual size_t memory() const
 		{
-			delete[] _dictionary;
+			return _ids.capacity() * sizeof(uint16_t);
 		}
 
-		void update_hamming(const tag_family_t& family, double size_scale = 3.0, bool stat = false)
+		// Bits of the code that differ from the tag code (id and rot as returned by decode).
+		uint64_t error(uint64_t code, uint16_t id, uint8_t rot) const
 		{
-			if (_create(family.hamming, size_scale) && stat)
-				_print_stat(family.name, "updated", size_scale);
+			// rotate90^rot(code) matches the tag code, so the tag code is rotated back.
+			uint64_t tag_code = _codes[id];
+			for (uint8_t k = 0; k < ((4 - rot) & 3); ++k)
+				tag_code = _rotate90(tag_code);
+			return code ^ tag_code;
 		}
 
-		bool decode(uint64_t code, uint16_t& id, uint8_t& hamming, uint8_t& rot) const
+		static inline uint32_t popcount(uint64_t v)
 		{
-			for (rot = 0; rot < 4; ++rot)
-			{
-				if (rot > 0)
-					code = _rotate90(code);
-				uint32_t hash = _hash(code);
-				for (uint32_t i = 0; i < _max_search; ++i)
-				{
-					const uint64_t dcode = _dictionary[hash].code;
-					if (dcode == std::numeric_limits<uint64_t>::max())
-						break;
-					else if (dcode == code)
-					{
-						id = _dictionary[hash].id;
-						hamming = _dictionary[hash].hamming;
-						return true;
-					}
-					hash = (hash + 1) % _size;
-				}
-			}
-			return false;
+			return _popcount(v);
 		}
 	};
-}
\ No newline at end of file
+}
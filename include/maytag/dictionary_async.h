@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "dictionary.h"
+#include "tag_family.h"
+
+
+namespace maytag::_
+{
+	// Dictionary built in the background.
+	// The hamming 0 dictionary is built in the constructor, so detection works immediately.
+	// The target level is built once in the background thread and swapped in atomically when ready.
+	// The previous level is released after the swap (decode keeps it alive until it returns).
+	class DictionaryAsync : public Dictionary
+	{
+	public:
+		// Creates the dictionary of the family (with family.hamming).
+		// cancel - set when the build is not needed anymore, the factory may stop early (the result is discarded).
+		using factory_t = std::function<std::shared_ptr<Dictionary> (const tag_family_t& family, const std::atomic<bool>& cancel)>;
+
+	private:
+		factory_t _factory;
+		std::shared_ptr<Dictionary> _dict; // Current dictionary (accessed with std::atomic_load/atomic_store).
+		std::atomic<uint8_t> _ready_hamming;
+		std::atomic<bool> _cancel;
+		uint8_t _target_hamming = 0;
+		std::thread _thread;
+		bool _stat = false;
+
+		void _build(tag_family_t family)
+		{
+			// A failed build (e.g. out of memory) keeps the current level.
+			std::shared_ptr<Dictionary> dict;
+			try
+			{
+				dict = _factory(family, _cancel);
+			}
+			catch (...)
+			{
+				dict.reset();
+			}
+			if (_cancel.load())
+				return;
+			if (!dict)
+			{
+				if (_stat)
+					std::cout << "MayTag dictionary (async) build failed\n"
+						<< "\tname: " << family.name << "\n"
+						<< "\thamming: " << static_cast<int>(family.hamming) << std::endl;
+				return;
+			}
+			std::atomic_store(&_dict, dict);
+			_ready_hamming.store(family.hamming, std::memory_order_release);
+			if (_stat)
+				std::cout << "MayTag dictionary (async) swapped\n"
+					<< "\tname: " << family.name << "\n"
+					<< "\thamming: " << static_cast<int>(family.hamming) << std::endl;
+		}
+
+		void _start(const tag_family_t& family)
+		{
+			if (_ready_hamming.load(std::memory_order_acquire) >= _target_hamming)
+				return;
+			tag_family_t target = family;
+			target.hamming = _target_hamming;
+			_cancel.store(false);
+			_thread = std::thread(&DictionaryAsync::_build, this, target);
+		}
+
+		// Stops the background build (the current level is kept).
+		void _stop()
+		{
+			_cancel.store(true);
+			wait();
+		}
+
+	public:
+		DictionaryAsync(const tag_family_t& family, factory_t factory, bool stat = false):
+			Dictionary(family),
+			_factory(std::move(factory)),
+			_ready_hamming(0),
+			_cancel(false),
+			_target_hamming(family.hamming),
+			_stat(stat)
+		{
+			tag_family_t family_0 = family;
+			family_0.hamming = 0;
+			_dict = _factory(family_0, _cancel);
+			_start(family);
+		}
+
+		// The background build is cancelled, so the destructor does not wait for it.
+		~DictionaryAsync()
+		{
+			_stop();
+		}
+
+		// Waits until the target level is built (or the build fails).
+		void wait()
+		{
+			if (_thread.joinable())
+				_thread.join();
+		}
+
+		// The hamming distance of the current dictionary.
+		uint8_t ready_hamming() const
+		{
+			return _ready_hamming.load(std::memory_order_acquire);
+		}
+
+		// Must not be called concurrently with decode (as for other dictionaries).
+		// A higher level replaces the build in progress.
+		void update_hamming(const tag_family_t& family, double size_scale = 3.0, bool stat = false) override
+		{
+			(void)size_scale;
+			if (family.hamming <= _target_hamming)
+				return;
+			_stop();
+			// The build thread reads _stat, so it is set after the thread is joined.
+			_stat = stat;
+			_target_hamming = family.hamming;
+			_start(family);
+		}
+
+		// The current dictionary (the level being built is not included).
+		size_t memory() const override
+		{
+			const std::shared_ptr<Dictionary> dict = std::atomic_load(&_dict);
+			return Dictionary::memory() + dict->memory();
+		}
+
+		bool decode(uint64_t code, uint16_t& id, uint8_t& hamming, uint8_t& rot) const override
+		{
+			const std::shared_ptr<Dictionary> dict = std::atomic_load(&_dict);
+			return dict->decode(code, id, hamming, rot);
+		}
+	};
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "dictionary.h"
+#include "tag_family.h"
+
+
+namespace maytag::_
+{
+	// Brute force search for small tag families.
+	// All rotated codes are stored in an aligned array (4 * ncodes * 8 B) and compared by XOR and popcount.
+	// With AVX2 (-mavx2 or -march=native) 4 codes are compared per instruction without branches.
+	class DictionaryBrute : public Dictionary
+	{
+	private:
+		std::vector<uint64_t> _data;
+		const uint64_t* _rcodes = nullptr; // _rcodes[i * 4 + k] = rotate90^k(code[_ids[i]]), 64 B aligned.
+		uint32_t _size = 0;
+
+		bool _create(uint8_t hamming)
+		{
+			if (hamming > _nbits)
+				hamming = _nbits;
+			if (hamming <= _max_hamming && _max_hamming != 255)
+				return false;
+			_max_hamming = hamming;
+			if (_rcodes)
+				return true;
+			_size = 4 * _ncodes;
+			_data.resize(_size + 8);
+			uint64_t* rcodes = _data.data();
+			while (reinterpret_cast<uintptr_t>(rcodes) % 64 != 0)
+				++rcodes;
+			for (uint32_t i = 0; i < _ncodes; ++i)
+			{
+				uint64_t code = _codes[_ids[i]];
+				for (uint32_t k = 0; k < 4; ++k)
+				{
+					rcodes[4 * i + k] = code;
+					code = _rotate90(code);
+				}
+			}
+			_rcodes = rcodes;
+			return true;
+		}
+
+		void _print_stat(const std::string& name, const std::string& text) const
+		{
+			std::cout << "MayTag dictionary (brute) " << text << "\n"
+				<< "\tname: " << name << "\n"
+				<< "\tncodes: " << _ncodes << "\n"
+				<< "\thamming: " << static_cast<int>(_max_hamming) << "\n"
+				<< "\tsize: " << _data.size() * sizeof(uint64_t) << " B" << std::endl;
+		}
+
+	public:
+		// Automatic selection of this dictionary for families with 4 * ncodes <= max_size.
+		static constexpr uint32_t max_size = 256;
+
+		DictionaryBrute(const tag_family_t& family, bool stat = false):
+			Dictionary(family)
+		{
+			if (_create(family.hamming) && stat)
+				_print_stat(family.name, "created");
+		}
+
+		void update_hamming(const tag_family_t& family, double size_scale = 3.0, bool stat = false) override
+		{
+			(void)size_scale;
+			if (_create(family.hamming) && stat)
+				_print_stat(family.name, "updated");
+		}
+
+		size_t memory() const override
+		{
+			return Dictionary::memory() + _data.capacity() * sizeof(uint64_t);
+		}
+
+		bool decode(uint64_t code, uint16_t& id, uint8_t& hamming, uint8_t& rot) const override
+		{
+			uint32_t best = _max_hamming + 1;
+			uint32_t best_i = 0;
+#if defined(__AVX2__)
+			// 4 codes per iteration, popcount by the nibble lookup (pshufb) and the sum of bytes (psadbw).
+			// Each lane keeps its own minimum (the first index on ties), the lanes are merged at the end.
+			const __m256i lookup = _mm256_setr_epi8(
+				0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+				0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+			const __m256i low_mask = _mm256_set1_epi8(0x0f);
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i step = _mm256_set1_epi64x(4);
+			const __m256i q = _mm256_set1_epi64x(static_cast<long long>(code));
+			__m256i cur_i = _mm256_setr_epi64x(0, 1, 2, 3);
+			__m256i lane_d = _mm256_set1_epi64x(best);
+			__m256i lane_i = zero;
+			for (uint32_t i = 0; i < _size; i += 4)
+			{
+				const __m256i x = _mm256_xor_si256(q, _mm256_load_si256(reinterpret_cast<const __m256i*>(_rcodes + i)));
+				const __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask));
+				const __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+				const __m256i d = _mm256_sad_epu8(_mm256_add_epi8(lo, hi), zero);
+				const __m256i lt = _mm256_cmpgt_epi64(lane_d, d);
+				lane_d = _mm256_blendv_epi8(lane_d, d, lt);
+				lane_i = _mm256_blendv_epi8(lane_i, cur_i, lt);
+				cur_i = _mm256_add_epi64(cur_i, step);
+			}
+			alignas(32) uint64_t ld[4];
+			alignas(32) uint64_t li[4];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(ld), lane_d);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(li), lane_i);
+			for (uint32_t k = 0; k < 4; ++k)
+			{
+				const uint32_t d = static_cast<uint32_t>(ld[k]);
+				const uint32_t i = static_cast<uint32_t>(li[k]);
+				if (d < best || (d == best && i < best_i))
+				{
+					best = d;
+					best_i = i;
+				}
+			}
+#else
+			for (uint32_t i = 0; i < _size; ++i)
+			{
+				const uint32_t d = _popcount(code ^ _rcodes[i]);
+				if (d < best)
+				{
+					best = d;
+					best_i = i;
+				}
+			}
+#endif
+			if (best > _max_hamming)
+				return false;
+			id = _ids[best_i >> 2];
+			hamming = best;
+			// The code is rotated k times, so the quad must be rotated back.
+			rot = (4 - (best_i & 3)) & 3;
+			return true;
+		}
+	};
+}
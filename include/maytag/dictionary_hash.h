@@ -0,0 +1,510 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "dict_table.h"
+#include "dictionary.h"
+#include "tag_family.h"
+
+
+namespace maytag::_
+{
+	// Hash table with all codes within the hamming distance (up to 3).
+	// Open addressing with power of two capacity and multiply-shift hash.
+	// The table is split into groups of 8 entries (one cache line), a group is checked at once (AVX-512/AVX2).
+	// Probing moves to the next group only if the group is full, so a miss usually touches one cache line.
+	class DictionaryHash : public Dictionary
+	{
+	private:
+		// Packed entry: code (bits 0-45), rotation (bits 46-47), hamming (bits 48-49), id (bits 50-63).
+		static constexpr uint32_t _code_bits = 46;
+		static constexpr uint64_t _code_mask = (static_cast<uint64_t>(1) << _code_bits) - 1;
+		// Real entries are never empty (id < max_ncodes).
+		static constexpr uint64_t _empty = std::numeric_limits<uint64_t>::max();
+		static constexpr uint32_t _group = 8;
+		// Bloom filter: bits per key, the minimum table size and the maximum filter size (both are a typical L2 cache).
+		static constexpr uint32_t _bloom_bits = 8;
+		static constexpr size_t _bloom_min_table = 1 << 20;
+		static constexpr size_t _bloom_max = 1 << 20;
+
+		std::vector<uint64_t> _data;
+		const uint64_t* _table = nullptr; // 64 B aligned (own _data, static or mapped table).
+		std::shared_ptr<const void> _owner; // Owner of the mapped table.
+		uint32_t _size = 0;         // Number of entries (power of two).
+		uint32_t _shift = 63;       // 64 - log2(number of groups).
+		uint32_t _group_mask = 0;
+		uint32_t _max_search = 0;   // Maximum number of groups to check.
+		bool _canonical = false;    // The key is the minimum of the code rotations.
+		double _build_ms = 0.0;
+		// Bloom filter of the keys (one 64-bit word per key, empty if the table is small).
+		std::vector<uint64_t> _bloom;
+		uint32_t _bloom_size = 0;
+		// Background build (DictionaryAsync): the build stops if it is set, the table is incomplete.
+		const std::atomic<bool>* _cancel = nullptr;
+
+		bool _cancelled() const
+		{
+			return _cancel && _cancel->load(std::memory_order_relaxed);
+		}
+
+		static inline uint32_t _hash(uint64_t code, uint32_t shift)
+		{
+			// Fibonacci hashing (high bits of the product).
+			return static_cast<uint32_t>((code * 0x9e3779b97f4a7c15ULL) >> shift);
+		}
+
+		inline uint32_t _hash(uint64_t code) const
+		{
+			return _hash(code, _shift);
+		}
+
+		static inline uint32_t _first_bit(uint32_t v)
+		{
+#if defined(__GNUC__)
+			return __builtin_ctz(v);
+#else
+			uint32_t i = 0;
+			while (!(v & 1))
+			{
+				v >>= 1;
+				++i;
+			}
+			return i;
+#endif
+		}
+
+		// Bit masks of the matched and empty entries in the group.
+		static inline void _match(const uint64_t* group, uint64_t code, uint32_t& match, uint32_t& empty)
+		{
+#if defined(__AVX512F__)
+			const __m512i g = _mm512_load_si512(group);
+			empty = _mm512_cmpeq_epi64_mask(g, _mm512_set1_epi64(static_cast<long long>(_empty)));
+			match = _mm512_cmpeq_epi64_mask(_mm512_and_si512(g, _mm512_set1_epi64(_code_mask)), _mm512_set1_epi64(static_cast<long long>(code)));
+			match &= ~empty;
+#elif defined(__AVX2__)
+			const __m256i e = _mm256_set1_epi64x(static_cast<long long>(_empty));
+			const __m256i m = _mm256_set1_epi64x(_code_mask);
+			const __m256i c = _mm256_set1_epi64x(static_cast<long long>(code));
+			const __m256i g0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(group));
+			const __m256i g1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(group + 4));
+			empty = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(g0, e)))
+				| (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(g1, e))) << 4);
+			match = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(g0, m), c)))
+				| (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(g1, m), c))) << 4);
+			match &= ~empty;
+#else
+			// The group is filled in order, so the scan stops at the first match or empty entry.
+			match = 0;
+			empty = 0;
+			for (uint32_t k = 0; k < _group; ++k)
+			{
+				if (group[k] == _empty)
+				{
+					empty = 1 << k;
+					break;
+				}
+				if ((group[k] & _code_mask) == code)
+				{
+					match = 1 << k;
+					break;
+				}
+			}
+#endif
+		}
+
+		// Word index and bit mask of the key in the bloom filter.
+		// All bits of the key are in one word, so a check is one memory access.
+		inline uint32_t _bloom_hash(uint64_t code, uint64_t& bits) const
+		{
+			uint64_t h = (code ^ (code >> 29)) * 0xbf58476d1ce4e5b9ULL;
+			h ^= h >> 32;
+			bits = (static_cast<uint64_t>(1) << (h & 63))
+				| (static_cast<uint64_t>(1) << ((h >> 6) & 63))
+				| (static_cast<uint64_t>(1) << ((h >> 12) & 63));
+			// Range reduction without division.
+			return static_cast<uint32_t>(((h >> 32) * _bloom_size) >> 32);
+		}
+
+		inline bool _bloom_check(uint64_t code) const
+		{
+			if (_bloom.empty())
+				return true;
+			uint64_t bits;
+			const uint32_t i = _bloom_hash(code, bits);
+			return (_bloom[i] & bits) == bits;
+		}
+
+		// The minimum of the code rotations: rotate90^rot(code) = result.
+		inline uint64_t _canonical_code(uint64_t code, uint32_t& rot) const
+		{
+			uint64_t min_code = code;
+			rot = 0;
+			for (uint32_t k = 1; k < 4; ++k)
+			{
+				code = _rotate90(code);
+				if (code < min_code)
+				{
+					min_code = code;
+					rot = k;
+				}
+			}
+			return min_code;
+		}
+
+		void _add(uint64_t* table, uint64_t code, uint16_t id, uint8_t hamming)
+		{
+			uint32_t rot = 0;
+			if (_canonical)
+				code = _canonical_code(code, rot);
+			if (!_bloom.empty())
+			{
+				uint64_t bits;
+				const uint32_t b = _bloom_hash(code, bits);
+				_bloom[b] |= bits;
+			}
+			uint32_t n = 1;
+			uint32_t g = _hash(code);
+			for (;;)
+			{
+				uint64_t* group = table + g * _group;
+				for (uint32_t k = 0; k < _group; ++k)
+				{
+					if (group[k] == _empty)
+					{
+						if (n > _max_search)
+							_max_search = n;
+						group[k] = code | (static_cast<uint64_t>(rot) << _code_bits) | (static_cast<uint64_t>(hamming) << (_code_bits + 2)) | (static_cast<uint64_t>(id) << (_code_bits + 4));
+						return;
+					}
+				}
+				g = (g + 1) & _group_mask;
+				++n;
+			}
+		}
+
+		void _set_size(uint32_t size)
+		{
+			_size = size;
+			_group_mask = size / _group - 1;
+			_shift = 64;
+			for (uint32_t n = size / _group; n > 1; n >>= 1)
+				--_shift;
+		}
+
+		// The bloom filter is used if the table does not fit in the L2 cache and the filter does.
+		// Larger filters are not used: they miss the cache as well (fewer bits per key give too many false positives).
+		void _init_bloom(size_t capacity)
+		{
+			_bloom.clear();
+			_bloom.shrink_to_fit();
+			_bloom_size = 0;
+			const size_t bloom_size = (capacity * _bloom_bits + 63) / 64;
+			if (_size * sizeof(uint64_t) > _bloom_min_table && bloom_size * sizeof(uint64_t) <= _bloom_max)
+			{
+				_bloom_size = static_cast<uint32_t>(bloom_size);
+				_bloom.assign(_bloom_size, 0);
+			}
+		}
+
+		// The bloom filter of the prebuilt or mapped table (it is not stored in the table).
+		void _load_bloom()
+		{
+			if (_size * sizeof(uint64_t) <= _bloom_min_table)
+				return;
+			size_t capacity = 0;
+			for (uint32_t i = 0; i < _size; ++i)
+				capacity += _table[i] != _empty;
+			_init_bloom(capacity);
+			if (_bloom.empty())
+				return;
+			for (uint32_t i = 0; i < _size; ++i)
+			{
+				if (_table[i] == _empty)
+					continue;
+				uint64_t bits;
+				const uint32_t b = _bloom_hash(_table[i] & _code_mask, bits);
+				_bloom[b] |= bits;
+			}
+		}
+
+		//
+		bool _create(uint8_t hamming, double size_scale)
+		{
+			if (hamming > 3)
+				hamming = 3;
+			if (hamming <= _max_hamming && _max_hamming != 255)
+				return false;
+			const auto t0 = std::chrono::steady_clock::now();
+			_max_hamming = hamming;
+			uint32_t capacity = _ncodes;
+			if (_max_hamming >= 1)
+				capacity += _ncodes * _nbits;
+			if (_max_hamming >= 2)
+				capacity += _ncodes * _nbits * (_nbits - 1) / 2;
+			if (_max_hamming >= 3)
+				capacity += _ncodes * _nbits * (_nbits - 1) * (_nbits - 2) / 6;
+			// The load factor is at most 1 / size_scale (and below 3/4).
+			// Entries are half the size of the unpacked ones, so the memory is at most the same after rounding up to power of two.
+			double min_size = capacity * size_scale;
+			if (min_size < capacity * 4.0 / 3.0)
+				min_size = capacity * 4.0 / 3.0;
+			uint32_t ngroups = 2;
+			while (static_cast<double>(ngroups) * _group < min_size)
+				ngroups <<= 1;
+			_set_size(ngroups * _group);
+			_owner.reset();
+			_data.clear();
+			_data.shrink_to_fit();
+			_data.assign(_size + _group, static_cast<uint64_t>(_empty));
+			uint64_t* table = _data.data();
+			while (reinterpret_cast<uintptr_t>(table) % 64 != 0)
+				++table;
+			_table = table;
+			_init_bloom(capacity);
+			_max_search = 0;
+			//
+			const uint64_t one = 1;
+			for (uint32_t i = 0; i < _ncodes; ++i)
+			{
+				const uint64_t code = _codes[_ids[i]];
+				_add(table, code, _ids[i], 0);
+			}
+			if (_max_hamming >= 1)
+			{
+				for (uint32_t i = 0; i < _ncodes && !_cancelled(); ++i)
+				{
+					const uint64_t code = _codes[_ids[i]];
+					for (uint32_t j = 0; j < _nbits; ++j)
+						_add(table, code ^ (one << j), _ids[i], 1);
+				}
+			}
+			if (_max_hamming >= 2)
+			{
+				for (uint32_t i = 0; i < _ncodes && !_cancelled(); ++i)
+				{
+					const uint64_t code = _codes[_ids[i]];
+					for (uint32_t j = 0; j < _nbits; ++j)
+					{
+						for (uint32_t k = 0; k < j; ++k)
+							_add(table, code ^ (one << j) ^ (one << k), _ids[i], 2);
+					}
+				}
+			}
+			if (_max_hamming >= 3)
+			{
+				for (uint32_t i = 0; i < _ncodes && !_cancelled(); ++i)
+				{
+					const uint64_t code = _codes[_ids[i]];
+					for (uint32_t j = 0; j < _nbits; ++j)
+					{
+						for (uint32_t k = 0; k < j; ++k)
+						{
+							for (uint32_t m = 0; m < k; ++m)
+								_add(table, code ^ (one << j) ^ (one << k) ^ (one << m), _ids[i], 3);
+						}
+					}
+				}
+			}
+			_build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+			return true;
+		}
+
+		// Entries of the loaded table: the ids and hamming are in range, the hamming is the distance to the code of the id
+		// and decode finds every entry (within max_search groups).
+		static bool _check_entries(const tag_family_t& family, const dict_table_t& table)
+		{
+			const uint64_t mask = (static_cast<uint64_t>(1) << table.nbits) - 1;
+			const uint32_t ngroups = table.size / _group;
+			if (table.max_search < 1 || table.max_search > ngroups)
+				return false;
+			uint32_t shift = 64;
+			for (uint32_t n = ngroups; n > 1; n >>= 1)
+				--shift;
+			for (uint32_t i = 0; i < table.size; ++i)
+			{
+				const uint64_t entry = table.table[i];
+				if (entry == _empty)
+					continue;
+				const uint64_t code = entry & _code_mask;
+				const uint32_t rot = static_cast<uint32_t>(entry >> _code_bits) & 3;
+				const uint32_t hamming = static_cast<uint32_t>(entry >> (_code_bits + 2)) & 3;
+				const uint32_t id = static_cast<uint32_t>(entry >> (_code_bits + 4));
+				if ((code >> table.nbits) != 0 || id >= table.ncodes || hamming > table.hamming || (rot != 0 && !table.canonical))
+					return false;
+				// The key is rotate90^rot of the code with the errors.
+				uint64_t tag_code = family.codes[id];
+				for (uint32_t k = 0; k < rot; ++k)
+					tag_code = _rotate90(tag_code, table.nbits, mask);
+				if (_popcount(code ^ tag_code) != hamming)
+					return false;
+				if (((i / _group - _hash(code, shift)) & (ngroups - 1)) >= table.max_search)
+					return false;
+			}
+			return true;
+		}
+
+		void _print_stat(const std::string& name, const std::string& text, double size_scale) const
+		{
+			std::cout << "MayTag dictionary (" << (_canonical ? "hash, canonical" : "hash") << ") " << text << "\n"
+				<< "\tname: " << name << "\n"
+				<< "\tncodes: " << _ncodes << "\n"
+				<< "\thamming: " << static_cast<int>(_max_hamming) << "\n"
+				<< "\tmax_search: " << _max_search << " groups\n"
+				<< "\tsize_scale: " << size_scale << "\n"
+				<< "\tprobes: " << (_canonical ? 1 : 4) << " per decode\n"
+				<< "\tbuild: " << _build_ms << " ms\n"
+				<< "\tbloom: " << _bloom.size() * sizeof(uint64_t) << " B\n"
+				<< "\tsize: " << _size * sizeof(uint64_t) << " B" << (_data.empty() ? (_owner ? " (mapped)" : " (static)") : "") << std::endl;
+		}
+
+	public:
+		// Version of the entry layout and the hash function (prebuilt tables and files).
+		static constexpr uint32_t table_version = 2;
+
+		// Maximum number of codes in the family (14 bits of the entry).
+		static constexpr uint32_t max_ncodes = (1 << 14) - 1;
+
+		// The packed entry limits the family (other families use DictionaryMih).
+		static bool supported(const tag_family_t& family)
+		{
+			return family.nbits <= _code_bits && family.ncodes <= max_ncodes;
+		}
+
+		// canonical - the key is the minimum of the code rotations (with the rotation in the entry).
+		// A decode checks one probe sequence instead of four (one per rotation).
+		// The memory is the same, the build is slower (the rotations of every added code).
+		// cancel - the build stops when it is set (the dictionary must not be used then).
+		DictionaryHash(const tag_family_t& family, double size_scale = 3.0, bool stat = false, bool canonical = false,
+			const std::atomic<bool>* cancel = nullptr):
+			Dictionary(family),
+			_canonical(canonical),
+			_cancel(cancel)
+		{
+			if (_create(family.hamming, size_scale) && stat && !_cancelled())
+				_print_stat(family.name, "created", size_scale);
+			_cancel = nullptr;
+		}
+
+		// Use the prebuilt table without copying (if it is valid for the family).
+		// Otherwise the table is built as usual.
+		DictionaryHash(const tag_family_t& family, const dict_table_t& table, double size_scale = 3.0, bool stat = false):
+			Dictionary(family)
+		{
+			if (valid(family, table))
+			{
+				_set_size(table.size);
+				_table = table.table;
+				_owner = table.owner;
+				_max_search = table.max_search;
+				_max_hamming = table.hamming;
+				_canonical = table.canonical;
+				_load_bloom();
+				if (stat)
+					_print_stat(family.name, "loaded", size_scale);
+			}
+			else if (_create(family.hamming, size_scale) && stat)
+				_print_stat(family.name, "created", size_scale);
+		}
+
+		// The header of the table matches the family.
+		// The hamming must be the same: a table of a higher level is larger and reports errors the family does not correct.
+		static bool compatible(const tag_family_t& family, const dict_table_t& table)
+		{
+			const uint8_t hamming = family.hamming < 3 ? family.hamming : 3;
+			// Tables are prebuilt for all codes only.
+			return table.table && family.ids.empty() && table.version == table_version && table.name == family.name
+				&& table.ncodes == family.ncodes && table.nbits == family.nbits && table.nbits <= _code_bits
+				&& table.hamming == hamming && table.size >= 2 * _group
+				&& (table.size & (table.size - 1)) == 0
+				&& reinterpret_cast<uintptr_t>(table.table) % 64 == 0;
+		}
+
+		// The table is compatible and its entries are consistent (a corrupted file is rejected).
+		// All entries are read, so the check takes about as long as reading the table once.
+		static bool valid(const tag_family_t& family, const dict_table_t& table)
+		{
+			return compatible(family, table) && _check_entries(family, table);
+		}
+
+		// View of the current table (for the generator).
+		dict_table_t table(const std::string& name) const
+		{
+			dict_table_t t;
+			t.name = name;
+			t.version = table_version;
+			t.ncodes = _ncodes;
+			t.nbits = _nbits;
+			t.hamming = _max_hamming;
+			t.size = _size;
+			t.max_search = _max_search;
+			t.canonical = _canonical;
+			t.table = _table;
+			t.owner = _owner;
+			return t;
+		}
+
+		void update_hamming(const tag_family_t& family, double size_scale = 3.0, bool stat = false) override
+		{
+			if (_create(family.hamming, size_scale) && stat)
+				_print_stat(family.name, "updated", size_scale);
+		}
+
+		size_t memory() const override
+		{
+			return Dictionary::memory() + (_data.capacity() + _bloom.capacity()) * sizeof(uint64_t);
+		}
+
+		bool decode(uint64_t code, uint16_t& id, uint8_t& hamming, uint8_t& rot) const override
+		{
+			uint32_t code_rot = 0;
+			if (_canonical)
+				code = _canonical_code(code, code_rot);
+			for (rot = 0; rot < 4; ++rot)
+			{
+				if (rot > 0)
+				{
+					if (_canonical)
+						break;
+					code = _rotate90(code);
+				}
+				if (!_bloom_check(code))
+					continue;
+				uint32_t g = _hash(code);
+				for (uint32_t i = 0; i < _max_search; ++i)
+				{
+					uint32_t match;
+					uint32_t empty;
+					_match(_table + g * _group, code, match, empty);
+					if (match)
+					{
+						// Entries are inserted in order, so the first match is the first added code.
+						const uint64_t entry = _table[g * _group + _first_bit(match)];
+						id = static_cast<uint16_t>(entry >> (_code_bits + 4));
+						hamming = static_cast<uint8_t>((entry >> (_code_bits + 2)) & 3);
+						if (_canonical)
+						{
+							// rotate90^code_rot(code) = rotate90^entry_rot(tag code).
+							const uint32_t entry_rot = static_cast<uint32_t>(entry >> _code_bits) & 3;
+							rot = (code_rot - entry_rot) & 3;
+						}
+						return true;
+					}
+					if (empty)
+						break;
+					g = (g + 1) & _group_mask;
+				}
+			}
+			return false;
+		}
+	};
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "dictionary.h"
+#include "tag_family.h"
+
+
+namespace maytag::_
+{
+	// Multi-index hashing.
+	// The code is split into hamming + 1 chunks.
+	// If the code is within the hamming distance, at least one chunk matches exactly (pigeonhole principle).
+	// Each chunk indexes all rotated codes, the candidates are verified by popcount.
+	// Memory does not depend on the hamming distance: (2^chunk_bits + 4 * ncodes) * 4 B per chunk.
+	class DictionaryMih : public Dictionary
+	{
+	private:
+		// Maximum number of bits in the chunk (size of the chunk index).
+		static constexpr uint32_t _max_chunk_bits = 12;
+		// Minimum number of bits in the chunk (limits the hamming distance).
+		static constexpr uint32_t _min_chunk_bits = 4;
+
+		struct chunk_t
+		{
+			uint32_t shift;
+			uint64_t mask;
+			std::vector<uint32_t> offset; // Bucket begin in item (size = 2^bits + 1).
+			std::vector<uint32_t> item;   // Rotated code index (i * 4 + rotation).
+		};
+
+		// Rotated codes: _rcodes[i * 4 + k] = rotate90^k(code[_ids[i]]).
+		std::vector<uint64_t> _rcodes;
+		std::vector<chunk_t> _chunks;
+		uint32_t _max_bucket = 0;
+
+		bool _create(uint8_t hamming)
+		{
+			const uint8_t hamming_max = _nbits / _min_chunk_bits - 1;
+			if (hamming > hamming_max)
+				hamming = hamming_max;
+			if (hamming <= _max_hamming && _max_hamming != 255)
+				return false;
+			_max_hamming = hamming;
+			//
+			const uint32_t nrcodes = 4 * _ncodes;
+			if (_rcodes.empty())
+			{
+				_rcodes.resize(nrcodes);
+				for (uint32_t i = 0; i < _ncodes; ++i)
+				{
+					uint64_t code = _codes[_ids[i]];
+					for (uint32_t k = 0; k < 4; ++k)
+					{
+						_rcodes[4 * i + k] = code;
+						code = _rotate90(code);
+					}
+				}
+			}
+			// Number of chunks.
+			uint32_t nchunks = _max_hamming + 1;
+			const uint32_t min_nchunks = (_nbits + _max_chunk_bits - 1) / _max_chunk_bits;
+			if (nchunks < min_nchunks)
+				nchunks = min_nchunks;
+			_chunks.clear();
+			_chunks.resize(nchunks);
+			_max_bucket = 0;
+			uint32_t shift = 0;
+			for (uint32_t c = 0; c < nchunks; ++c)
+			{
+				auto& chunk = _chunks[c];
+				const uint32_t bits = _nbits / nchunks + (c < _nbits % nchunks ? 1 : 0);
+				const uint32_t nbuckets = static_cast<uint32_t>(1) << bits;
+				chunk.shift = shift;
+				chunk.mask = nbuckets - 1;
+				shift += bits;
+				// Counting sort by the chunk value.
+				chunk.offset.assign(nbuckets + 1, 0);
+				for (uint32_t i = 0; i < nrcodes; ++i)
+					++chunk.offset[((_rcodes[i] >> chunk.shift) & chunk.mask) + 1];
+				for (uint32_t b = 0; b < nbuckets; ++b)
+				{
+					if (chunk.offset[b + 1] > _max_bucket)
+						_max_bucket = chunk.offset[b + 1];
+					chunk.offset[b + 1] += chunk.offset[b];
+				}
+				chunk.item.resize(nrcodes);
+				std::vector<uint32_t> pos(chunk.offset.begin(), chunk.offset.end() - 1);
+				for (uint32_t i = 0; i < nrcodes; ++i)
+					chunk.item[pos[(_rcodes[i] >> chunk.shift) & chunk.mask]++] = i;
+			}
+			return true;
+		}
+
+		size_t _memory() const
+		{
+			size_t size = _rcodes.size() * sizeof(uint64_t);
+			for (const auto& chunk : _chunks)
+				size += (chunk.offset.size() + chunk.item.size()) * sizeof(uint32_t);
+			return size;
+		}
+
+		void _print_stat(const std::string& name, const std::string& text) const
+		{
+			std::cout << "MayTag dictionary (mih) " << text << "\n"
+				<< "\tname: " << name << "\n"
+				<< "\tncodes: " << _ncodes << "\n"
+				<< "\thamming: " << static_cast<int>(_max_hamming) << "\n"
+				<< "\tchunks: " << _chunks.size() << "\n"
+				<< "\tmax_bucket: " << _max_bucket << "\n"
+				<< "\tsize: " << _memory() << " B" << std::endl;
+		}
+
+	public:
+		DictionaryMih(const tag_family_t& family, bool stat = false):
+			Dictionary(family)
+		{
+			if (_create(family.hamming) && stat)
+				_print_stat(family.name, "created");
+		}
+
+		void update_hamming(const tag_family_t& family, double size_scale = 3.0, bool stat = false) override
+		{
+			(void)size_scale;
+			if (_create(family.hamming) && stat)
+				_print_stat(family.name, "updated");
+		}
+
+		size_t memory() const override
+		{
+			return Dictionary::memory() + _memory();
+		}
+
+		bool decode(uint64_t code, uint16_t& id, uint8_t& hamming, uint8_t& rot) const override
+		{
+			uint32_t best = _max_hamming + 1;
+			uint32_t best_i = 0;
+			for (const auto& chunk : _chunks)
+			{
+				const uint64_t key = (code >> chunk.shift) & chunk.mask;
+				const uint32_t end = chunk.offset[key + 1];
+				for (uint32_t k = chunk.offset[key]; k < end; ++k)
+				{
+					const uint32_t i = chunk.item[k];
+					const uint32_t d = _popcount(code ^ _rcodes[i]);
+					if (d < best || (d == best && i < best_i))
+					{
+						best = d;
+						best_i = i;
+					}
+				}
+				if (best == 0)
+					break;
+			}
+			if (best > _max_hamming)
+				return false;
+			id = _ids[best_i >> 2];
+			hamming = best;
+			// The code is rotated k times, so the quad must be rotated back.
+			rot = (4 - (best_i & 3)) & 3;
+			return true;
+		}
+	};
+}
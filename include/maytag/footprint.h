@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+namespace maytag
+{
+	// Bytes held by the detector stages (the buffers grow with the largest frame and are kept).
+	struct memory_t
+	{
+		size_t decimate = 0;
+		size_t mask = 0;      // Tiles and spans of set_roi and set_mask.
+		size_t threshold = 0;
+		size_t contours = 0;  // Labels, roots and the contour points.
+		size_t quad = 0;
+		size_t decode = 0;    // Including the contexts of the decode threads.
+		size_t dict = 0;      // Dictionaries of the families (each dictionary once).
+
+		size_t stages() const
+		{
+			return decimate + mask + threshold + contours + quad + decode;
+		}
+
+		size_t total() const
+		{
+			return stages() + dict;
+		}
+	};
+
+	// Dictionary of the detector.
+	struct dict_memory_t
+	{
+		std::string name;     // Tag family name.
+		uint8_t hamming = 0;
+		size_t bytes = 0;     // Heap of the dictionary (prebuilt and mapped tables are not included).
+		bool shared = false;  // Also used by other detectors (see set_dict_shared).
+	};
+}
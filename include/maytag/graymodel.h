@@ -7,47 +7,51 @@ namespace maytag::_
 {
 	// Computes the cholesky factorization of a, putting the lower triangular matrix into r.
 	// a - upper triangular matrix.
-	void mat33_chol(const double* const a, double* const r)
+	template <typename T>
+	void mat33_chol(const T* const a, T* const r)
 	{
+		using std::sqrt;
 		// a[0] = r[0]*r[0]
-		r[0] = std::sqrt(a[0]);
+		r[0] = sqrt(a[0]);
 		// a[1] = r[0]*r[3]
 		r[3] = a[1] / r[0];
 		// a[2] = r[0]*r[6]
 		r[6] = a[2] / r[0];
 		// a[4] = r[3]*r[3] + r[4]*r[4]
-		r[4] = std::sqrt(a[3] - r[3] * r[3]);
+		r[4] = sqrt(a[3] - r[3] * r[3]);
 		// a[5] = r[3]*r[6] + r[4]*r[7]
 		r[7] = (a[4] - r[3] * r[6]) / r[4];
 		// a[8] = r[6]*r[6] + r[7]*r[7] + r[8]*r[8]
-		r[8] = std::sqrt(a[5] - r[6] * r[6] - r[7] * r[7]);
-		r[1] = 0.0;
-		r[2] = 0.0;
-		r[5] = 0.0;
+		r[8] = sqrt(a[5] - r[6] * r[6] - r[7] * r[7]);
+		r[1] = T(0);
+		r[2] = T(0);
+		r[5] = T(0);
 	}
 
-	void mat33_lower_tri_inv(const double* const a, double* const r)
+	template <typename T>
+	void mat33_lower_tri_inv(const T* const a, T* const r)
 	{
 		// a[0]*r[0] = 1
-		r[0] = 1.0 / a[0];
+		r[0] = T(1) / a[0];
 		// a[3]*r[0] + a[4]*r[3] = 0
 		r[3] = -a[3] * r[0] / a[4];
 		// a[4]*r[4] = 1
-		r[4] = 1.0 / a[4];
+		r[4] = T(1) / a[4];
 		// a[6]*r[0] + a[7]*r[3] + a[8]*r[6] = 0
 		r[6] = (-a[6] * r[0] - a[7] * r[3]) / a[8];
 		// a[7]*r[4] + a[8]*r[7] = 0
 		r[7] = -a[7] * r[4] / a[8];
 		// a[8]*r[8] = 1
-		r[8] = 1 / a[8];
+		r[8] = T(1) / a[8];
 	}
 
 	// a - upper triangular matrix.
-	void mat33_sym_solve(const double* const a, const double* const b, double* const r)
+	template <typename T>
+	void mat33_sym_solve(const T* const a, const T* const b, T* const r)
 	{
-		double t[9];
+		T t[9];
 		mat33_chol(a, t);
-		double m[9];
+		T m[9];
 		mat33_lower_tri_inv(t, m);
 		//
 		t[0] = m[0] * b[0];
@@ -66,22 +70,29 @@ namespace maytag::_
 	// J = |x2 y2 1|
 	//     |  ...  |
 	// The a matrix is J'J
+	template <typename T>
 	struct graymodel_t
 	{
 		// a - upper triangular matrix.
 		// | 0 1 2 |
 		// |   3 4 |
 		// |     5 |
-		double a[6];
-		double b[3];
-		double c[3];
+		T a[6];
+		T b[3];
+		T c[3];
 
 		graymodel_t()
 		{
-			std::memset(this, 0, sizeof(graymodel_t));
+			for (int i = 0; i < 6; ++i)
+				a[i] = T(0);
+			for (int i = 0; i < 3; ++i)
+			{
+				b[i] = T(0);
+				c[i] = T(0);
+			}
 		}
 
-		void add(double x, double y, double gray)
+		void add(T x, T y, T gray)
 		{
 			// Update upper right entries of A = J'J.
 			a[0] += x * x;
@@ -89,7 +100,7 @@ namespace maytag::_
 			a[2] += x;
 			a[3] += y * y;
 			a[4] += y;
-			a[5] += 1.0;
+			a[5] += T(1);
 			// Update B = J'gray.
 			b[0] += x * gray;
 			b[1] += y * gray;
@@ -101,9 +112,9 @@ namespace maytag::_
 			mat33_sym_solve(a, b, c);
 		}
 
-		double interpolate(double x, double y)
+		T interpolate(T x, T y) const
 		{
 			return c[0] * x + c[1] * y + c[2];
 		}
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+
+namespace maytag
+{
+	// Latency histogram (ms) with the relative error of the values about 3% (HDR-style log-linear buckets).
+	// Values are stored in ns: exactly below 64 ns, then 32 buckets per power of two up to 2^40 ns (about 18 minutes).
+	class histogram_t
+	{
+	private:
+		static constexpr uint32_t _sub = 32;
+		static constexpr uint32_t _size = 36 * _sub;
+		static constexpr uint64_t _max_ns = (1ull << 40) - 1;
+
+		std::vector<uint32_t> _count; // Allocated by the first add.
+		uint64_t _total = 0;
+		uint64_t _min = 0;
+		uint64_t _max = 0;
+		double _sum = 0.0;
+
+		static uint32_t _index(uint64_t v)
+		{
+			if (v < 2 * _sub)
+				return static_cast<uint32_t>(v);
+			uint32_t shift = 0;
+			while ((v >> shift) >= 2 * _sub)
+				++shift;
+			return shift * _sub + static_cast<uint32_t>(v >> shift);
+		}
+
+		// The highest value of the bucket.
+		static uint64_t _value(uint32_t idx)
+		{
+			if (idx < 2 * _sub)
+				return idx;
+			const uint32_t shift = idx / _sub - 1;
+			const uint64_t m = idx - shift * _sub;
+			return ((m + 1) << shift) - 1;
+		}
+
+	public:
+		void add(double ms)
+		{
+			double ns = ms * 1e6;
+			if (ns < 0.0)
+				ns = 0.0;
+			const uint64_t v = ns < static_cast<double>(_max_ns) ? static_cast<uint64_t>(ns + 0.5) : _max_ns;
+			if (_count.empty())
+				_count.assign(_size, 0);
+			++_count[_index(v)];
+			if (_total == 0 || v < _min)
+				_min = v;
+			if (v > _max)
+				_max = v;
+			++_total;
+			_sum += ms;
+		}
+
+		void operator+=(const histogram_t& h)
+		{
+			if (h._total == 0)
+				return;
+			if (_count.empty())
+				_count.assign(_size, 0);
+			for (uint32_t i = 0; i < _size; ++i)
+				_count[i] += h._count[i];
+			if (_total == 0 || h._min < _min)
+				_min = h._min;
+			if (h._max > _max)
+				_max = h._max;
+			_total += h._total;
+			_sum += h._sum;
+		}
+
+		// Starts a new window (the memory is kept).
+		void reset()
+		{
+			if (!_count.empty())
+				_count.assign(_size, 0);
+			_total = 0;
+			_min = 0;
+			_max = 0;
+			_sum = 0.0;
+		}
+
+		uint64_t count() const
+		{
+			return _total;
+		}
+
+		double min() const
+		{
+			return _min * 1e-6;
+		}
+
+		double max() const
+		{
+			return _max * 1e-6;
+		}
+
+		double mean() const
+		{
+			return _total > 0 ? _sum / _total : 0.0;
+		}
+
+		// Value (ms) that p percent of the values do not exceed, for example percentile(99.9).
+		double percentile(double p) const
+		{
+			if (_total == 0)
+				return 0.0;
+			if (p >= 100.0)
+				return max();
+			uint64_t rank = static_cast<uint64_t>(p * 0.01 * _total + 0.5);
+			if (rank < 1)
+				rank = 1;
+			uint64_t n = 0;
+			for (uint32_t i = 0; i < _size; ++i)
+			{
+				n += _count[i];
+				if (n >= rank)
+				{
+					const uint64_t v = _value(i);
+					return (v < _max ? v : _max) * 1e-6;
+				}
+			}
+			return max();
+		}
+	};
+
+	// Latency histograms of the detector stages (the same stages as timing_t) and of the whole frame.
+	// Filled only if MAYTAG_TIMING is defined before including maytag.
+	struct latency_t
+	{
+		histogram_t decimate;
+		histogram_t threshold;
+		histogram_t contour_label;
+		histogram_t contour_collect;
+		histogram_t quad_sort;
+		histogram_t quad_fit;
+		histogram_t quad_refine;
+		histogram_t decode;
+		histogram_t dict;
+		histogram_t total; // Detector::calc (the sum of the stages except dict).
+
+		void reset()
+		{
+			for (histogram_t* h : {&decimate, &threshold, &contour_label, &contour_collect, &quad_sort, &quad_fit, &quad_refine, &decode, &dict, &total})
+				h->reset();
+		}
+	};
+}
@@ -23,4 +23,23 @@ namespace maytag
 		{
 		}
 	};
+
+	// Rectangle in the image pixels (x1 and y1 are exclusive).
+	struct roi_t
+	{
+		uint32_t x0;
+		uint32_t y0;
+		uint32_t x1;
+		uint32_t y1;
+
+		roi_t():
+			x0(0), y0(0), x1(0), y1(0)
+		{
+		}
+
+		roi_t(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1):
+			x0(x0), y0(y0), x1(x1), y1(y1)
+		{
+		}
+	};
 }
\ No newline at end of file
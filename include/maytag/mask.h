@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "cfg.h"
+#include "image.h"
+#include "pt.h"
+
+
+namespace maytag::_
+{
+	// Range of the pixels in a row (x1 is exclusive).
+	struct span_t
+	{
+		uint32_t x0;
+		uint32_t x1;
+	};
+
+	// Active area of the image (cfg_t::roi and cfg_t::mask) at the threshold tile resolution.
+	// Threshold processes only the active tiles, Contours only the rows spans around them
+	// and Quad drops quads with corners outside of them.
+	class Mask
+	{
+	private:
+		const cfg_t* const _cfg;
+		uint32_t _version = 0;
+		uint32_t _w = 0;        // Input image size.
+		uint32_t _h = 0;
+		uint32_t _dw = 0;       // Decimated image size.
+		uint32_t _dh = 0;
+		uint32_t _tile_size = 0;
+		uint32_t _tw = 0;
+		uint32_t _th = 0;
+		double _sx = 1.0;       // Input pixels per decimated pixel.
+		double _sy = 1.0;
+		std::vector<uint8_t> _tiles;
+		std::vector<uint8_t> _stat_tiles;
+		// Spans of the contour rows: [_span_idx[2 * ty], _span_idx[2 * ty + 1]) - the first row of the tile row ty
+		// (it also reads the previous tile row), [_span_idx[2 * ty + 1], _span_idx[2 * ty + 2]) - other rows.
+		std::vector<span_t> _spans;
+		std::vector<uint32_t> _span_idx;
+		std::vector<span_t> _tmp;
+
+		bool _active(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const
+		{
+			for (const auto& roi : _cfg->roi)
+			{
+				if (roi.x0 < x1 && x0 < roi.x1 && roi.y0 < y1 && y0 < roi.y1)
+					return true;
+			}
+			const uint32_t mw = _cfg->mask_w;
+			const uint32_t mh = _cfg->mask_h;
+			if (_cfg->mask.empty() || mw == 0 || mh == 0)
+				return false;
+			const uint32_t cx0 = static_cast<uint32_t>(static_cast<uint64_t>(x0) * mw / _w);
+			const uint32_t cy0 = static_cast<uint32_t>(static_cast<uint64_t>(y0) * mh / _h);
+			const uint32_t cx1 = std::min<uint32_t>(mw, static_cast<uint32_t>((static_cast<uint64_t>(x1) * mw + _w - 1) / _w));
+			const uint32_t cy1 = std::min<uint32_t>(mh, static_cast<uint32_t>((static_cast<uint64_t>(y1) * mh + _h - 1) / _h));
+			for (uint32_t cy = cy0; cy < cy1; ++cy)
+			{
+				for (uint32_t cx = cx0; cx < cx1; ++cx)
+				{
+					if (_cfg->mask[cy * mw + cx])
+						return true;
+				}
+			}
+			return false;
+		}
+
+		// Active tiles of the row ty as pixel spans.
+		void _row_spans(uint32_t ty, std::vector<span_t>& spans) const
+		{
+			const uint8_t* tiles = _tiles.data() + ty * _tw;
+			for (uint32_t tx = 0; tx < _tw; ++tx)
+			{
+				if (!tiles[tx])
+					continue;
+				const uint32_t x0 = tx * _tile_size;
+				const uint32_t x1 = (tx == _tw - 1) ? _dw : x0 + _tile_size;
+				if (!spans.empty() && spans.back().x1 == x0)
+					spans.back().x1 = x1;
+				else
+					spans.push_back({x0, x1});
+			}
+		}
+
+		// The 2x2 window of Contours also reads the pixel on the left, so the spans are extended by one pixel.
+		void _add_spans()
+		{
+			std::sort(_tmp.begin(), _tmp.end(), [](const span_t& a, const span_t& b) { return a.x0 < b.x0; });
+			const size_t beg = _spans.size();
+			for (const auto& s : _tmp)
+			{
+				const uint32_t x1 = std::min(s.x1 + 1, _dw);
+				if (_spans.size() > beg && _spans.back().x1 >= s.x0)
+					_spans.back().x1 = std::max(_spans.back().x1, x1);
+				else
+					_spans.push_back({s.x0, x1});
+			}
+			_span_idx.push_back(static_cast<uint32_t>(_spans.size()));
+		}
+
+		void _update()
+		{
+			_tiles.assign(_tw * _th, 0);
+			for (uint32_t ty = 0; ty < _th; ++ty)
+			{
+				const uint32_t dy0 = ty * _tile_size;
+				const uint32_t dy1 = (ty == _th - 1) ? _dh : dy0 + _tile_size;
+				const uint32_t y0 = static_cast<uint32_t>(dy0 * _sy);
+				const uint32_t y1 = std::min(_h, static_cast<uint32_t>(dy1 * _sy + 0.999));
+				for (uint32_t tx = 0; tx < _tw; ++tx)
+				{
+					const uint32_t dx0 = tx * _tile_size;
+					const uint32_t dx1 = (tx == _tw - 1) ? _dw : dx0 + _tile_size;
+					const uint32_t x0 = static_cast<uint32_t>(dx0 * _sx);
+					const uint32_t x1 = std::min(_w, static_cast<uint32_t>(dx1 * _sx + 0.999));
+					_tiles[ty * _tw + tx] = _active(x0, y0, x1, y1) ? 1 : 0;
+				}
+			}
+			// The threshold of a tile depends on the 3x3 neighbour tiles.
+			_stat_tiles.assign(_tw * _th, 0);
+			for (uint32_t ty = 0; ty < _th; ++ty)
+			{
+				for (uint32_t tx = 0; tx < _tw; ++tx)
+				{
+					if (!_tiles[ty * _tw + tx])
+						continue;
+					for (uint32_t y = (ty > 0 ? ty - 1 : 0); y <= std::min(ty + 1, _th - 1); ++y)
+					{
+						for (uint32_t x = (tx > 0 ? tx - 1 : 0); x <= std::min(tx + 1, _tw - 1); ++x)
+							_stat_tiles[y * _tw + x] = 1;
+					}
+				}
+			}
+			_spans.clear();
+			_span_idx.assign(1, 0);
+			for (uint32_t ty = 0; ty < _th; ++ty)
+			{
+				_tmp.clear();
+				if (ty > 0)
+					_row_spans(ty - 1, _tmp);
+				_row_spans(ty, _tmp);
+				_add_spans();
+				_tmp.clear();
+				_row_spans(ty, _tmp);
+				_add_spans();
+			}
+		}
+
+	public:
+		Mask(const cfg_t* cfg) :
+			_cfg(cfg)
+		{
+		}
+
+		// Returns false if the whole image is active.
+		bool calc(const image_t& gray_img, const image_t& decimate_img)
+		{
+			if (_cfg->roi.empty() && _cfg->mask.empty())
+				return false;
+			const uint32_t tile_size = _cfg->tile_size;
+			if (_version == _cfg->mask_version && _w == gray_img.w && _h == gray_img.h
+				&& _dw == decimate_img.w && _dh == decimate_img.h && _tile_size == tile_size)
+				return true;
+			_version = _cfg->mask_version;
+			_w = gray_img.w;
+			_h = gray_img.h;
+			_dw = decimate_img.w;
+			_dh = decimate_img.h;
+			_tile_size = tile_size;
+			_tw = _dw / tile_size;
+			_th = _dh / tile_size;
+			if (_tw == 0 || _th == 0)
+			{
+				_version = _cfg->mask_version - 1;
+				return false;
+			}
+			_sx = static_cast<double>(_w) / _dw;
+			_sy = static_cast<double>(_h) / _dh;
+			_update();
+			return true;
+		}
+
+		// Tiles to process (tw * th).
+		const uint8_t* tiles() const
+		{
+			return _tiles.data();
+		}
+
+		// Tiles to collect the min/max statistics of (the active tiles and their neighbours).
+		const uint8_t* stat_tiles() const
+		{
+			return _stat_tiles.data();
+		}
+
+		// Spans of the decimated image row y (y >= 1) for Contours.
+		// Windows outside of them consist of the unknown pixels only.
+		const span_t* spans(uint32_t y, const span_t*& end) const
+		{
+			uint32_t ty = y / _tile_size;
+			uint32_t k = 1;
+			if (ty >= _th)
+				ty = _th - 1;
+			else if (y == ty * _tile_size)
+				k = 0;
+			end = _spans.data() + _span_idx[2 * ty + k + 1];
+			return _spans.data() + _span_idx[2 * ty + k];
+		}
+
+		// All corners of the quad (in the input image) are in the active tiles.
+		template <typename T>
+		bool inside(const basic_pt_t<T>* const p) const
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				const double x = static_cast<double>(p[i].x) / _sx;
+				const double y = static_cast<double>(p[i].y) / _sy;
+				uint32_t tx = x > 0.0 ? static_cast<uint32_t>(x) / _tile_size : 0;
+				uint32_t ty = y > 0.0 ? static_cast<uint32_t>(y) / _tile_size : 0;
+				if (tx >= _tw)
+					tx = _tw - 1;
+				if (ty >= _th)
+					ty = _th - 1;
+				if (!_tiles[ty * _tw + tx])
+					return false;
+			}
+			return true;
+		}
+
+		// Bytes held.
+		size_t memory() const
+		{
+			return _tiles.capacity() + _stat_tiles.capacity() + (_spans.capacity() + _tmp.capacity()) * sizeof(span_t)
+				+ _span_idx.capacity() * sizeof(uint32_t);
+		}
+	};
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "detector.h"
+#include "pipeline.h"
+#include "tracker.h"
 #include "image.h"
 #include "tag.h"
 #include "tag_family.h"
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#if defined(MAYTAG_PERF) && defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace maytag
+{
+	// Hardware counters (user space of the calling thread).
+	struct perf_t
+	{
+		uint64_t cycles = 0;
+		uint64_t instructions = 0;
+		uint64_t cache_misses = 0;
+		uint64_t branch_misses = 0;
+
+		inline void operator+=(const perf_t& v)
+		{
+			cycles += v.cycles;
+			instructions += v.instructions;
+			cache_misses += v.cache_misses;
+			branch_misses += v.branch_misses;
+		}
+
+		// The share k (0 - 1) of the counters.
+		inline perf_t part(double k) const
+		{
+			perf_t v;
+			v.cycles = static_cast<uint64_t>(cycles * k + 0.5);
+			v.instructions = static_cast<uint64_t>(instructions * k + 0.5);
+			v.cache_misses = static_cast<uint64_t>(cache_misses * k + 0.5);
+			v.branch_misses = static_cast<uint64_t>(branch_misses * k + 0.5);
+			return v;
+		}
+	};
+
+	// Hardware counters of the detector stages in the last frame (the same stages as timing_t).
+	// Filled only if MAYTAG_PERF is defined before including maytag (Linux, perf_event_open).
+	// The counters are read in the thread of calc, so the extra decode threads are not included.
+	struct perf_stat_t
+	{
+		perf_t decimate;
+		perf_t threshold;
+		perf_t contour_label;
+		perf_t contour_collect;
+		perf_t quad_sort;   // The quad counters are read once per frame and split by the time of the steps.
+		perf_t quad_fit;    // Without MAYTAG_TIMING all of them are in quad_fit.
+		perf_t quad_refine;
+		perf_t decode;
+	};
+
+	namespace _
+	{
+		// Group of the perf_t counters of the current thread.
+		// Counters that can not be opened (no PMU in a VM, perf_event_paranoid) stay zero.
+		class PerfGroup
+		{
+#if defined(MAYTAG_PERF) && defined(__linux__)
+		private:
+			int _fd = -1;      // Group leader.
+			int _other[3] = {-1, -1, -1};
+			int _idx[4] = {-1, -1, -1, -1}; // Position of the counter in the group read.
+			uint32_t _size = 0;
+
+			static int _open(uint64_t config, int group_fd)
+			{
+				perf_event_attr attr;
+				std::memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.config = config;
+				attr.read_format = PERF_FORMAT_GROUP;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.disabled = (group_fd == -1) ? 1 : 0;
+				return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+			}
+
+			PerfGroup()
+			{
+				const uint64_t config[4] = {
+					PERF_COUNT_HW_CPU_CYCLES,
+					PERF_COUNT_HW_INSTRUCTIONS,
+					PERF_COUNT_HW_CACHE_MISSES,
+					PERF_COUNT_HW_BRANCH_MISSES
+				};
+				for (uint32_t i = 0; i < 4; ++i)
+				{
+					const int fd = _open(config[i], _fd);
+					if (fd < 0)
+						continue;
+					if (_fd < 0)
+						_fd = fd;
+					else
+						_other[_size - 1] = fd;
+					_idx[i] = _size++;
+				}
+				if (_fd >= 0)
+				{
+					ioctl(_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+					ioctl(_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+				}
+			}
+
+		public:
+			~PerfGroup()
+			{
+				for (int fd : _other)
+				{
+					if (fd >= 0)
+						close(fd);
+				}
+				if (_fd >= 0)
+					close(_fd);
+			}
+
+			PerfGroup(const PerfGroup&) = delete;
+			PerfGroup& operator=(const PerfGroup&) = delete;
+
+			static PerfGroup& thread()
+			{
+				static thread_local PerfGroup group;
+				return group;
+			}
+
+			bool available() const
+			{
+				return _fd >= 0;
+			}
+
+			bool read(perf_t& v) const
+			{
+				if (_fd < 0)
+					return false;
+				uint64_t data[5]; // nr, values.
+				const ssize_t size = static_cast<ssize_t>((1 + _size) * sizeof(uint64_t));
+				if (::read(_fd, data, size) != size)
+					return false;
+				v.cycles = _idx[0] >= 0 ? data[1 + _idx[0]] : 0;
+				v.instructions = _idx[1] >= 0 ? data[1 + _idx[1]] : 0;
+				v.cache_misses = _idx[2] >= 0 ? data[1 + _idx[2]] : 0;
+				v.branch_misses = _idx[3] >= 0 ? data[1 + _idx[3]] : 0;
+				return true;
+			}
+#else
+		public:
+			static PerfGroup& thread()
+			{
+				static PerfGroup group;
+				return group;
+			}
+
+			bool available() const
+			{
+				return false;
+			}
+
+			bool read(perf_t&) const
+			{
+				return false;
+			}
+#endif
+		};
+	}
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "contours.h"
+#include "detector.h"
+#include "histogram.h"
+#include "image.h"
+#include "tag.h"
+
+
+namespace maytag
+{
+	namespace _
+	{
+		// Queue of the slot indices between the pipeline stages.
+		// The queues are bounded by the number of slots (each slot is in one queue at a time).
+		class SlotQueue
+		{
+		private:
+			std::mutex _mutex;
+			std::condition_variable _cv;
+			std::deque<uint32_t> _queue;
+			bool _closed = false;
+
+		public:
+			void push(uint32_t slot)
+			{
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_queue.push_back(slot);
+				}
+				_cv.notify_one();
+			}
+
+			// Waits for the next slot. Returns false if the queue is closed.
+			bool pop(uint32_t& slot)
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_cv.wait(lock, [this]() { return _closed || !_queue.empty(); });
+				if (_queue.empty())
+					return false;
+				slot = _queue.front();
+				_queue.pop_front();
+				return true;
+			}
+
+			void close()
+			{
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_closed = true;
+				}
+				_cv.notify_all();
+			}
+		};
+	}
+
+	// Detector pipelined across consecutive frames.
+	// The front thread labels the frame N + 1 (decimate, threshold, contour label)
+	// while the back thread finishes the frame N (contour collect, quads, decode).
+	// The split is by cost: each half takes about half of Detector::calc on a typical scene (see the benchmark).
+	// Each frame goes through a slot (a copy of the image and of the threshold image, its labels and tags),
+	// so the stages never share buffers.
+	// The number of slots bounds the frames in flight, pop returns the results in push order.
+	// push and pop are called from one thread, for example: push the frame, pop when pending() == slots().
+	// Throughput is limited by the slower of the two halves (it needs two free cores), latency is at least Detector::calc.
+	template <typename T>
+	class BasicPipeline
+	{
+	private:
+		struct slot_t
+		{
+			std::vector<uint8_t> data;
+			image_t img;
+			std::unique_ptr<_::Contours> contours; // Labels from the front to the back thread.
+			std::vector<uint8_t> thresh_data;
+			image_t thresh_img;
+			std::vector<tag_t> tags;
+			Stopwatch sw; // From push.
+		};
+
+		BasicDetector<T> _detector;
+		std::vector<slot_t> _slots;
+		SlotQueue _front; // Frames waiting for calc_labels.
+		SlotQueue _back;  // Frames waiting for calc_quads and calc_tags.
+		SlotQueue _done;  // Results waiting for pop.
+		std::thread _front_thread;
+		std::thread _back_thread;
+		uint32_t _head = 0;    // Slot of the oldest pushed frame (the slots are used in turn).
+		uint32_t _pending = 0; // Pushed but not popped.
+		histogram_t _latency;  // From push to pop.
+
+		void _front_loop()
+		{
+			uint32_t i;
+			while (_front.pop(i))
+			{
+				slot_t& slot = _slots[i];
+				// The threshold image is copied, the front thread overwrites it with the next frame.
+				const image_t thresh_img = _detector.calc_labels(slot.img, *slot.contours);
+				slot.thresh_data.assign(thresh_img.d, thresh_img.d + static_cast<size_t>(thresh_img.w) * thresh_img.h);
+				slot.thresh_img = image_t(thresh_img.w, thresh_img.h, slot.thresh_data.data());
+				_back.push(i);
+			}
+		}
+
+		void _back_loop()
+		{
+			uint32_t i;
+			while (_back.pop(i))
+			{
+				slot_t& slot = _slots[i];
+				const auto& quads = _detector.calc_quads(slot.img, slot.thresh_img, *slot.contours);
+				const auto& tags = _detector.calc_tags(quads, slot.img);
+				slot.tags.assign(tags.begin(), tags.end());
+				_done.push(i);
+			}
+		}
+
+		void _start()
+		{
+			if (_front_thread.joinable())
+				return;
+			_front_thread = std::thread(&BasicPipeline::_front_loop, this);
+			_back_thread = std::thread(&BasicPipeline::_back_loop, this);
+		}
+
+	public:
+		// slots >= 2 (one frame per stage), 3 also hides the time of push and pop.
+		BasicPipeline(uint32_t slots = 3):
+			_slots(slots < 2 ? 2 : slots)
+		{
+			for (auto& slot : _slots)
+				slot.contours = _detector.make_contours();
+		}
+
+		~BasicPipeline()
+		{
+			_front.close();
+			_back.close();
+			_done.close();
+			if (_front_thread.joinable())
+			{
+				// The queues are closed, so the stages stop after the current frame.
+				_front_thread.join();
+				_back_thread.join();
+			}
+		}
+
+		BasicPipeline(const BasicPipeline&) = delete;
+		BasicPipeline& operator=(const BasicPipeline&) = delete;
+
+		// The detector is configured before the first push (the stages read its configuration without locks).
+		BasicDetector<T>& detector()
+		{
+			return _detector;
+		}
+
+		// Copies the image into the next slot and queues it.
+		// Returns false if all slots are in flight (the oldest result must be popped first).
+		bool push(const image_t& gray_img)
+		{
+			if (_pending == _slots.size())
+				return false;
+			_start();
+			const uint32_t i = (_head + _pending) % _slots.size();
+			slot_t& slot = _slots[i];
+			const size_t size = static_cast<size_t>(gray_img.w) * gray_img.h;
+			slot.data.resize(size);
+			std::memcpy(slot.data.data(), gray_img.d, size);
+			slot.img = image_t(gray_img.w, gray_img.h, slot.data.data());
+			slot.sw = Stopwatch(false);
+			++_pending;
+			_front.push(i);
+			return true;
+		}
+
+		// Waits for the result of the oldest pushed frame. Returns false if there are no pushed frames.
+		bool pop(std::vector<tag_t>& tags)
+		{
+			if (_pending == 0)
+				return false;
+			uint32_t i = 0;
+			_done.pop(i);
+			tags.swap(_slots[i].tags);
+#if defined(MAYTAG_TIMING)
+			double ms = 0.0;
+			_slots[i].sw.lap(ms);
+			_latency.add(ms);
+#endif
+			_head = (_head + 1) % _slots.size();
+			--_pending;
+			return true;
+		}
+
+		// Number of pushed frames without popped results.
+		uint32_t pending() const
+		{
+			return _pending;
+		}
+
+		uint32_t slots() const
+		{
+			return static_cast<uint32_t>(_slots.size());
+		}
+
+		// End-to-end latency histogram (from push to pop, including the waiting in the queues).
+		// Filled only if MAYTAG_TIMING is defined, the stages are in detector().latency().
+		const histogram_t& latency() const
+		{
+			return _latency;
+		}
+
+		// Starts a new window of the latency histograms (also of the detector, call when no frames are pending).
+		void reset_latency()
+		{
+			_latency.reset();
+			_detector.reset_latency();
+		}
+	};
+
+	using Pipeline = BasicPipeline<double>;
+	using PipelineF = BasicPipeline<float>;
+	using PipelineFixed = BasicPipeline<fixed_t>;
+}
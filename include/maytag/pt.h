@@ -3,9 +3,13 @@
 
 namespace maytag
 {
-	struct pt_t
+	// T - precision of the coordinates (the detector stages keep the precision of the detector).
+	template <typename T>
+	struct basic_pt_t
 	{
-		double x;
-		double y;
+		T x;
+		T y;
 	};
+
+	using pt_t = basic_pt_t<double>;
 }
\ No newline at end of file
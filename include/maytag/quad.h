@@ -7,30 +7,106 @@
 
 #include "cfg.h"
 #include "contours.h"
+#include "fixed.h"
+#include "mask.h"
 #include "pt.h"
+#include "timing.h"
 
 
 namespace maytag::_
 {
-	struct quad_t
+	// T - precision of the corners (the same as the detector, so Quad and Decode do not convert them).
+	template <typename T>
+	struct basic_quad_t
 	{
-		pt_t p[4];  // Corners.
+		basic_pt_t<T> p[4];  // Corners.
 		bool black; //
 	};
 
+	using quad_t = basic_quad_t<double>;
+
+	// Quad counters of the last frame (each rejected contour is counted once, by the first failed check).
+	struct quad_stat_t
+	{
+		uint32_t contours = 0;  // Input contours.
+		uint32_t tag_size = 0;  // Bounding box smaller than min_tag_size.
+		uint32_t center = 0;    // Contour point closer than center_eps to the center.
+		uint32_t quarters = 0;  // Points not in all quarters around the center.
+		uint32_t dot = 0;       // Gradients are not consistent (dot_thresh).
+		uint32_t border = 0;    // Border color of no added family.
+		uint32_t short_contour = 0; // Too few points for the error filter.
+		uint32_t maxima = 0;    // Less than 4 corner candidates.
+		uint32_t lines = 0;     // No 4 lines within max_line_fit_mse and max_cos.
+		uint32_t line_mse = 0;  // Line candidates rejected by max_line_fit_mse (not contours).
+		uint32_t line_cos = 0;  // Line pairs rejected by max_cos (not contours).
+		uint32_t corners = 0;   // Corners can not be calculated (parallel lines).
+		uint32_t side = 0;      // Side shorter than min_tag_size.
+		uint32_t convex = 0;    // Not convex.
+		uint32_t area = 0;      // Area less than min_tag_area.
+		uint32_t outside = 0;   // Outside of the mask.
+		uint32_t refine = 0;    // Edge refinement failed.
+		uint32_t quads = 0;     // Output quads.
+	};
+
+	// Precision of the contour line fit.
+	// The fit sums are large, so float is not enough and double is used instead.
+	// relative - the sums are accumulated relative to the first contour point (Q16 keeps the precision only for small sums).
+	// refine_relative - the edge refinement is computed relative to the quad corner (float and fixed_t, double is kept as is).
+	template <typename T>
+	struct fit_precision_t
+	{
+		using type = double;
+		static constexpr bool relative = false;
+		static constexpr bool refine_relative = true;
+	};
+
+	template <>
+	struct fit_precision_t<double>
+	{
+		using type = double;
+		static constexpr bool relative = false;
+		static constexpr bool refine_relative = false;
+	};
+
+	template <>
+	struct fit_precision_t<fixed_t>
+	{
+		using type = fixed_t;
+		static constexpr bool relative = true;
+		static constexpr bool refine_relative = true;
+	};
+
+	// Mean of the weighted sum.
+	template <typename T>
+	inline T fit_mean(T sum, T, T inv_w)
+	{
+		return sum * inv_w;
+	}
+
+	// For fixed_t, 1 / w is too coarse and the sum is divided directly.
+	inline fixed_t fit_mean(fixed_t sum, fixed_t w, fixed_t)
+	{
+		return sum / w;
+	}
+
+	// T - precision of the edge refinement.
+	template <typename T>
 	class Quad
 	{
 	private:
+		using F = typename fit_precision_t<T>::type;
+
+		template <typename U>
 		struct fit_data_t
 		{
-			double w = 0.0;
-			double wx = 0.0;
-			double wy = 0.0;
-			double wxx = 0.0;
-			double wyy = 0.0;
-			double wxy = 0.0;
-
-			inline void operator+=(const fit_data_t& v)
+			U w = U(0);
+			U wx = U(0);
+			U wy = U(0);
+			U wxx = U(0);
+			U wyy = U(0);
+			U wxy = U(0);
+
+			inline void operator+=(const fit_data_t<U>& v)
 			{
 				w += v.w;
 				wx += v.wx;
@@ -40,7 +116,7 @@ namespace maytag::_
 				wxy += v.wxy;
 			}
 
-			inline void operator-=(const fit_data_t& v)
+			inline void operator-=(const fit_data_t<U>& v)
 			{
 				w -= v.w;
 				wx -= v.wx;
@@ -51,48 +127,51 @@ namespace maytag::_
 			}
 		};
 
+		template <typename U>
 		struct line_param_t
 		{
-			double px;  // Point on the line.
-			double py;  // Point on the line.
-			double dx;  // Line direction.
-			double dy;  // Line direction.
-			double cxx;
-			double cyy;
-			double cxy;
-			double sq;
-
-			double calc_point(const fit_data_t& fd)
+			U px;  // Point on the line.
+			U py;  // Point on the line.
+			U dx;  // Line direction.
+			U dy;  // Line direction.
+			U cxx;
+			U cyy;
+			U cxy;
+			U sq;
+
+			U calc_point(const fit_data_t<U>& fd)
 			{
-				const double inv_w = 1.0 / fd.w;
-				px = fd.wx * inv_w;
-				py = fd.wy * inv_w;
-				cxx = fd.wxx * inv_w - px * px;
-				cyy = fd.wyy * inv_w - py * py;
-				cxy = fd.wxy * inv_w - px * py;
-				sq = std::sqrt((cxx - cyy) * (cxx - cyy) + 4.0 * cxy * cxy);
-				return 0.5 * (cxx + cyy - sq);
+				const U inv_w = U(1) / fd.w;
+				px = fit_mean(fd.wx, fd.w, inv_w);
+				py = fit_mean(fd.wy, fd.w, inv_w);
+				cxx = fit_mean(fd.wxx, fd.w, inv_w) - px * px;
+				cyy = fit_mean(fd.wyy, fd.w, inv_w) - py * py;
+				cxy = fit_mean(fd.wxy, fd.w, inv_w) - px * py;
+				using std::sqrt;
+				sq = sqrt((cxx - cyy) * (cxx - cyy) + U(4) * cxy * cxy);
+				return U(0.5) * (cxx + cyy - sq);
 			}
 
 			void calc_direction()
 			{
-				double eig = 0.5 * (cxx + cyy + sq);
-				double nx1 = cxx - eig;
-				double ny1 = cxy;
-				double m1 = nx1 * nx1 + ny1 * ny1;
-				double nx2 = cxy;
-				double ny2 = cyy - eig;
-				double m2 = nx2 * nx2 + ny2 * ny2;
+				using std::sqrt;
+				U eig = U(0.5) * (cxx + cyy + sq);
+				U nx1 = cxx - eig;
+				U ny1 = cxy;
+				U m1 = nx1 * nx1 + ny1 * ny1;
+				U nx2 = cxy;
+				U ny2 = cyy - eig;
+				U m2 = nx2 * nx2 + ny2 * ny2;
 				if (m1 > m2)
 				{
-					const double norm = 1.0 / std::sqrt(m1);
+					const U norm = U(1) / sqrt(m1);
 					// Rotate the normal (nx, ny) by 90 degrees.
 					dx = -ny1 * norm;
 					dy = nx1 * norm;
 				}
 				else
 				{
-					const double norm = 1.0 / std::sqrt(m2);
+					const U norm = U(1) / sqrt(m2);
 					// Rotate the normal (nx, ny) by 90 degrees.
 					dx = -ny2 * norm;
 					dy = nx2 * norm;
@@ -101,15 +180,35 @@ namespace maytag::_
 		};
 
 		const cfg_t* const _cfg;
-		std::vector<double> _filter;
-		std::vector<fit_data_t> _fit_data;
-		std::vector<quad_t> _quads;
+		std::vector<F> _filter;
+		std::vector<fit_data_t<F>> _fit_data;
+		std::vector<basic_quad_t<T>> _quads;
+		quad_stat_t _stat;
+		double _time_sort = 0.0;
+		double _time_fit = 0.0;
+		double _time_refine = 0.0;
+		perf_t _perf_sort;
+		perf_t _perf_fit;
+		perf_t _perf_refine;
+		// Config in the precision of the math (see update_cfg).
+		F _quad_decimate;
+		F _center_eps;     // In the decimated image.
+		F _min_tag_size;
+		F _min_tag_size_2;
+		F _min_tag_area;
+		F _dot_thresh;
+		F _max_cos;
+		F _max_line_fit_mse;
+		T _refine_range;
+		T _grange;
+		// Origin of the fit data (the first contour point if fit_precision_t::relative).
+		F _fit_ox;
+		F _fit_oy;
 
 		// Sort contour points around the center.
 		// Border color check.
-		bool _sort_contour(std::vector<cpt_t>& contour, quad_t& quad)
+		bool _sort_contour(std::vector<cpt_t>& contour, basic_quad_t<T>& quad)
 		{
-			const double quad_decimate = _cfg->quad_decimate;
 			const uint32_t size = contour.size();
 			// Calculate the bounding box.
 			uint16_t x_max = contour[0].x;
@@ -130,49 +229,54 @@ namespace maytag::_
 			}
 			// Quick check tag size.
 			{
-				double dx = (x_max - x_min) * quad_decimate;
-				if (dx < _cfg->min_tag_size)
-					return false;
-				double dy = (y_max - y_min) * quad_decimate;
-				if (dy < _cfg->min_tag_size)
+				const F dx = F(x_max - x_min) * _quad_decimate;
+				const F dy = F(y_max - y_min) * _quad_decimate;
+				if (dx < _min_tag_size || dy < _min_tag_size)
+				{
+					++_stat.tag_size;
 					return false;
+				}
 			}
 			// Sort contour points around the center.
-			const double cx = (x_min + x_max) * 0.5 + 0.01;
-			const double cy = (y_min + y_max) * 0.5 + 0.01;
-			const double eps = _cfg->center_eps / quad_decimate;
+			const F cx = F(x_min + x_max) * F(0.5) + F(0.01);
+			const F cy = F(y_min + y_max) * F(0.5) + F(0.01);
+			const F eps = _center_eps;
 			int32_t dot = 0;
 			// Points must be in all quarters.
 			uint8_t mask = 0;
 			for (uint32_t i = 0; i < size; ++i)
 			{
 				auto& p = contour[i];
-				const double dx = p.x - cx;
-				const double dy = p.y - cy;
+				const F dx = F(p.x) - cx;
+				const F dy = F(p.y) - cy;
 				//
-				const double cos_a = dx * p.gx + dy * p.gy;
-				if (cos_a > 0)
+				const F cos_a = dx * F(p.gx) + dy * F(p.gy);
+				if (cos_a > F(0))
 					++dot;
 				else
 					--dot;
 				// Calculate the order (from 0 to 64 000) of points.
 				// Right or left.
-				if (std::abs(dx) > std::abs(dy))
+				using std::abs;
+				if (abs(dx) > abs(dy))
 				{
 					// Right order: 8000 * [0.0, 2.0].
 					if (dx > eps)
 					{
-						p.order = static_cast<uint16_t>(8000.0 * (1.0 - dy / dx));
+						p.order = static_cast<uint16_t>(F(8000) * (F(1) - dy / dx));
 						mask |= 1;
 					}
 					// Left order: 8000 * [4.0, 6.0].
 					else if (dx < -eps)
 					{
-						p.order = static_cast<uint16_t>(8000.0 * (5.0 - dy / dx));
+						p.order = static_cast<uint16_t>(F(8000) * (F(5) - dy / dx));
 						mask |= 2;
 					}
 					else
+					{
+						++_stat.center;
 						return false;
+					}
 				}
 				// Top or bottom.
 				else
@@ -180,28 +284,40 @@ namespace maytag::_
 					// Top order: 8000 * [2.0, 4.0].
 					if (dy < -eps)
 					{
-						p.order = static_cast<uint16_t>(8000.0 * (3.0 + dx / dy));
+						p.order = static_cast<uint16_t>(F(8000) * (F(3) + dx / dy));
 						mask |= 4;
 					}
 					// Bottom order: 8000 * [6.0, 8.0].
 					else if (dy > eps)
 					{
-						p.order = static_cast<uint16_t>(8000.0 * (7.0 + dx / dy));
+						p.order = static_cast<uint16_t>(F(8000) * (F(7) + dx / dy));
 						mask |= 8;
 					}
 					else
+					{
+						++_stat.center;
 						return false;
+					}
 				}
 			}
 			if (mask != 15)
+			{
+				++_stat.quarters;
 				return false;
-			if (std::abs(dot) < size * _cfg->dot_thresh)
+			}
+			if (F(std::abs(dot)) < F(size) * _dot_thresh)
+			{
+				++_stat.dot;
 				return false;
+			}
 			bool black = (dot < 0);
 			// Drop the contours of the wrong border type.
 			uint8_t border_mask = black ? 1 : 2;
 			if ((_cfg->border_mask & border_mask) == 0)
+			{
+				++_stat.border;
 				return false;
+			}
 			quad.black = black;
 			// quad.p[0].x = x_min * quad_decimate;
 			// quad.p[0].y = y_min * quad_decimate;
@@ -219,13 +335,17 @@ namespace maytag::_
 		}
 
 		//
-		inline bool _check_max_cos(const line_param_t& lp1, const line_param_t& lp2) const
+		inline bool _check_max_cos(const line_param_t<F>& lp1, const line_param_t<F>& lp2)
 		{
-			return (std::abs(lp1.dx * lp2.dx + lp1.dy * lp2.dy) < _cfg->max_cos);
+			using std::abs;
+			if (abs(lp1.dx * lp2.dx + lp1.dy * lp2.dy) < _max_cos)
+				return true;
+			++_stat.line_cos;
+			return false;
 		}
 
 		// Get fit_data from range.
-		inline void _get_fit_data(int32_t i0, int32_t i1, fit_data_t& fd) const
+		inline void _get_fit_data(int32_t i0, int32_t i1, fit_data_t<F>& fd) const
 		{
 			fd = _fit_data[i1];
 			if (i0 > 0)
@@ -235,28 +355,33 @@ namespace maytag::_
 		}
 
 		//
-		inline void _fit_line_mse(int32_t i0, int32_t i1, double& mse, line_param_t& line_parm) const
+		inline void _fit_line_mse(int32_t i0, int32_t i1, F& mse, line_param_t<F>& line_parm) const
 		{
-			fit_data_t fd;
+			fit_data_t<F> fd;
 			_get_fit_data(i0, i1, fd);
 			mse = line_parm.calc_point(fd);
 		}
 
 		//
-		bool _fit_line(int32_t i0, int32_t i1, double& mse, line_param_t& line_parm) const
+		bool _fit_line(int32_t i0, int32_t i1, F& mse, line_param_t<F>& line_parm)
 		{
-			fit_data_t fd;
+			fit_data_t<F> fd;
 			_get_fit_data(i0, i1, fd);
 			mse = line_parm.calc_point(fd);
-			if (mse > _cfg->max_line_fit_mse)
+			if (mse > _max_line_fit_mse)
+			{
+				++_stat.line_mse;
 				return false;
+			}
 			line_parm.calc_direction();
 			return true;
 		}
 
 		// Calculation of tag corners.
 		// lp - array of size 4.
-		bool _calc_corners(const line_param_t* const lp, quad_t& quad) const
+		// c - corners in the precision U (x0, y0, x1, y1, ...).
+		template <typename U>
+		bool _calc_corners(const line_param_t<U>* const lp, basic_quad_t<T>& quad, U* const c) const
 		{
 			for (uint32_t i = 0; i < 4; i++)
 			{
@@ -267,47 +392,54 @@ namespace maytag::_
 				// =>
 				// |d0_x  -d1_x| |lambda0|   |p1_x - p0_x|
 				// |d0_y  -d1_y| |lambda1| = |p1_y - p0_y|
-				const line_param_t& lp_0 = lp[i];
-				const line_param_t& lp_1 = lp[(i + 1) & 3];
-				double a00 =  lp_0.dx;
-				double a01 = -lp_1.dx;
-				double a10 =  lp_0.dy;
-				double a11 = -lp_1.dy;
-				double b0 = lp_1.px - lp_0.px;
-				double b1 = lp_1.py - lp_0.py;
+				const line_param_t<U>& lp_0 = lp[i];
+				const line_param_t<U>& lp_1 = lp[(i + 1) & 3];
+				U a00 =  lp_0.dx;
+				U a01 = -lp_1.dx;
+				U a10 =  lp_0.dy;
+				U a11 = -lp_1.dy;
+				U b0 = lp_1.px - lp_0.px;
+				U b1 = lp_1.py - lp_0.py;
 				//
-				double det = a00 * a11 - a10 * a01;
-				if (std::abs(det) < 0.001)
+				U det = a00 * a11 - a10 * a01;
+				using std::abs;
+				if (abs(det) < U(0.001))
 					return false;
 				// Inverse.
-				double w00 =  a11 / det;
-				double w01 = -a01 / det;
+				U w00 =  a11 / det;
+				U w01 = -a01 / det;
 				// Solve.
-				double l0 = w00 * b0 + w01 * b1;
-				quad.p[i].x = lp_0.px + l0 * lp_0.dx;
-				quad.p[i].y = lp_0.py + l0 * lp_0.dy;
+				U l0 = w00 * b0 + w01 * b1;
+				c[2 * i] = lp_0.px + l0 * lp_0.dx;
+				c[2 * i + 1] = lp_0.py + l0 * lp_0.dy;
+				quad.p[i].x = T(c[2 * i]);
+				quad.p[i].y = T(c[2 * i + 1]);
 			}
 			return true;
 		}
 
 		void _prepare_fit_data(const image_t& gray_img, const std::vector<cpt_t>& contour)
 		{
-			const double quad_decimate = _cfg->quad_decimate;
+			const F quad_decimate = _quad_decimate;
 			const uint32_t size = contour.size();
 			const uint8_t* const img = gray_img.d;
 			const uint32_t iw = gray_img.w;
 			const uint32_t ih = gray_img.h;
 			_fit_data.clear();
 			_fit_data.reserve(size);
-			fit_data_t sum;
+			_fit_ox = fit_precision_t<T>::relative ? F(contour[0].x) * quad_decimate : F(0);
+			_fit_oy = fit_precision_t<T>::relative ? F(contour[0].y) * quad_decimate : F(0);
+			fit_data_t<F> sum;
 			for (uint32_t i = 0; i < size; ++i)
 			{
 				const auto& p = contour[i];
-				const double x = p.x * quad_decimate;
-				const double y = p.y * quad_decimate;
-				double w = 1.0;
-				uint32_t ix = static_cast<uint32_t>(x + 0.5);
-				uint32_t iy = static_cast<uint32_t>(y + 0.5);
+				const F px = F(p.x) * quad_decimate;
+				const F py = F(p.y) * quad_decimate;
+				const F x = px - _fit_ox;
+				const F y = py - _fit_oy;
+				F w = F(1);
+				uint32_t ix = static_cast<uint32_t>(px + F(0.5));
+				uint32_t iy = static_cast<uint32_t>(py + F(0.5));
 				if (ix > 0 && iy > 0 && ix < iw && iy < ih)
 				{
 					//  3 | 2
@@ -336,7 +468,7 @@ namespace maytag::_
 						i_min = v;
 					else if (v > i_max)
 						i_max = v;
-					w += i_max - i_min;
+					w += F(i_max - i_min);
 				}
 				//
 				sum.w += w;
@@ -349,17 +481,17 @@ namespace maytag::_
 			}
 		}
 
-		bool _find_quad(quad_t& quad) const
+		bool _find_quad(basic_quad_t<T>& quad)
 		{
 			const uint32_t size = _fit_data.size();
-			std::vector<double> err1(size);
-			std::vector<double> err2(size);
+			std::vector<F> err1(size);
+			std::vector<F> err2(size);
 			// Collect errors.
 			// err1
 			{
 				// min_contour_size >= 24 => ksz >= 1
 				const uint32_t ksz = std::min(static_cast<uint32_t>(20), size / 24);
-				line_param_t lp;
+				line_param_t<F> lp;
 				for (uint32_t i = 0; i < size; ++i)
 					_fit_line_mse((i + size - ksz) % size, (i + ksz) % size, err1[i], lp);
 			}
@@ -368,11 +500,14 @@ namespace maytag::_
 			{
 				const uint32_t f_size = _filter.size();
 				if (size < f_size)
+				{
+					++_stat.short_contour;
 					return false;
+				}
 				const uint32_t beg = size - f_size / 2;
 				for (uint32_t i = 0; i < size; i++)
 				{
-					double acc = 0.0;
+					F acc = F(0);
 					for (uint32_t f = 0, j = beg + i; f < f_size; ++f, ++j)
 						acc += _filter[f] * err1[j % size];
 					err2[i] = acc;
@@ -382,7 +517,7 @@ namespace maytag::_
 			// err1 = maxima(err2)
 			std::vector<uint32_t> maxima;
 			{
-				const double min_err = 0.01;
+				const F min_err = F(0.01);
 				err1.clear();
 				maxima.reserve(size / 6);
 				if (err2[0] > min_err && err2[0] > err2[size - 1] && err2[0] > err2[1])
@@ -406,13 +541,16 @@ namespace maytag::_
 			}
 			uint32_t maxima_size = maxima.size();
 			if (maxima_size < 4)
+			{
+				++_stat.maxima;
 				return false;
+			}
 			// Get best max_nmaxima.
 			if (maxima_size > _cfg->max_nmaxima)
 			{
 				err2 = err1;
-				std::nth_element(err2.begin(), err2.begin() + _cfg->max_nmaxima, err2.end(), std::greater<double>());
-				const double tresh = err2[_cfg->max_nmaxima];
+				std::nth_element(err2.begin(), err2.begin() + _cfg->max_nmaxima, err2.end(), std::greater<F>());
+				const F tresh = err2[_cfg->max_nmaxima];
 				const uint32_t i_max = maxima_size;
 				maxima_size = 0;
 				for (uint32_t i = 0; i < i_max; ++i)
@@ -422,10 +560,11 @@ namespace maytag::_
 				}
 			}
 			//
-			double err[4];
-			double best_err = std::numeric_limits<double>::max();
-			line_param_t lp[4];
-			line_param_t best_lp[4];
+			F err[4];
+			F best_err = F(0);
+			bool found = false;
+			line_param_t<F> lp[4];
+			line_param_t<F> best_lp[4];
 			for (uint32_t m0 = 0; m0 < maxima_size - 3; ++m0)
 			{
 				const uint32_t i0 = maxima[m0];
@@ -454,65 +593,94 @@ namespace maytag::_
 								continue;
 							if (!_check_max_cos(lp[3], lp[0]))
 								continue;
-							double e = err[0] + err[1] + err[2] + err[3];
-							if (e < best_err)
+							F e = err[0] + err[1] + err[2] + err[3];
+							if (!found || e < best_err)
 							{
+								found = true;
 								best_err = e;
-								std::memcpy(best_lp, lp, 4 * sizeof(line_param_t));
+								std::memcpy(best_lp, lp, 4 * sizeof(line_param_t<F>));
 							}
 						}
 					}
 				}
 			}
-			if (best_err == std::numeric_limits<double>::max())
+			if (!found)
+			{
+				++_stat.lines;
 				return false;
+			}
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				best_lp[i].px += _fit_ox;
+				best_lp[i].py += _fit_oy;
+			}
 			//
-			if (!_calc_corners(best_lp, quad))
+			F c[8];
+			if (!_calc_corners(best_lp, quad, c))
+			{
+				++_stat.corners;
 				return false;
+			}
 			// Check tag size.
-			const double min_tag_size = _cfg->min_tag_size * _cfg->min_tag_size;
 			for (uint32_t i = 0; i < 4; i++)
 			{
-				const auto& p1 = quad.p[i];
-				const auto& p2 = quad.p[(i + 1) & 3];
-				double dx21 = p1.x - p2.x;
-				double dy21 = p1.y - p2.y;
-				if (dx21 * dx21 + dy21 * dy21 < min_tag_size)
+				const F* const p1 = c + 2 * i;
+				const F* const p2 = c + 2 * ((i + 1) & 3);
+				F dx21 = p1[0] - p2[0];
+				F dy21 = p1[1] - p2[1];
+				if (dx21 * dx21 + dy21 * dy21 < _min_tag_size_2)
+				{
+					++_stat.side;
 					return false;
+				}
 				// Check convex.
-				const auto& p3 = quad.p[(i + 2) & 3];
-				double dx23 = p3.x - p2.x;
-				double dy23 = p3.y - p2.y;
+				const F* const p3 = c + 2 * ((i + 2) & 3);
+				F dx23 = p3[0] - p2[0];
+				F dy23 = p3[1] - p2[1];
 				if (dx21 * dy23 < dy21 * dx23)
+				{
+					++_stat.convex;
 					return false;
+				}
 			}
 			// Area of a convex quadrilateral.
-			const auto& p = quad.p;
-			double area = p[0].x * p[3].y - p[3].x * p[0].y;
+			F area = c[0] * c[7] - c[6] * c[1];
 			for (uint32_t i = 0; i < 3; ++i)
-				area += p[i + 1].x * p[i].y - p[i].x * p[i + 1].y;
-			area *= 0.5;
+				area += c[2 * i + 2] * c[2 * i + 1] - c[2 * i] * c[2 * i + 3];
+			area *= F(0.5);
 			// Reject quads that are too small.
-			if (area < _cfg->min_tag_area)
+			if (area < _min_tag_area)
+			{
+				++_stat.area;
 				return false;
+			}
 			return true;
 		}
 
-		// 
-		bool _refine_edges(const image_t& gray_img, quad_t& quad) const
+		// Precision of the refinement math is T.
+		bool _refine_edges(const image_t& gray_img, basic_quad_t<T>& quad) const
 		{
 			const uint8_t* const img = gray_img.d;
 			const uint32_t w = gray_img.w;
 			const uint32_t h = gray_img.h;
-			line_param_t lp[4];
+			line_param_t<T> lp[4];
 			for (uint32_t i = 0; i < 4; ++i)
 			{
-				const pt_t pa = quad.p[i];
-				const pt_t pb = quad.p[(i + 1) & 3];
+				const basic_pt_t<T>& pa = quad.p[i];
+				const basic_pt_t<T>& pb = quad.p[(i + 1) & 3];
+				// Points are accumulated relative to pb if fit_precision_t::refine_relative.
+				// This keeps the line fit sums small, so T = float does not lose precision.
+				const T ox = fit_precision_t<T>::refine_relative ? pb.x : T(0);
+				const T oy = fit_precision_t<T>::refine_relative ? pb.y : T(0);
+				const T bx = pb.x - ox;
+				const T by = pb.y - oy;
+				const T ax = pa.x - pb.x;
+				const T ay = pa.y - pb.y;
 				// Compute the normal to the current line estimate.
-				double nx = pb.y - pa.y;
-				double ny = pa.x - pb.x;
-				double mag = std::sqrt(nx * nx + ny * ny);
+				T nx = -ay;
+				T ny = ax;
+				using std::sqrt;
+				T mag = sqrt(nx * nx + ny * ny);
 				nx /= mag;
 				ny /= mag;
 				if (quad.black)
@@ -522,40 +690,40 @@ namespace maytag::_
 				}
 				// We will now fit a NEW line by sampling points near our original line that have large gradients.
 				// On really big tags, we're willing to sample more to get an even better estimate.
-				uint32_t nsamples = static_cast<uint32_t>(mag / 8);
+				uint32_t nsamples = static_cast<uint32_t>(mag / T(8));
 				if (nsamples < 16)
 					nsamples = 16;
 				// How far to search?
 				// We want to search far enough that we find the best edge, but not so far that we hit other edges that aren't part of the tag.
 				// We shouldn't ever have to search more than quad_decimate, since otherwise we would (ideally) have started our search on another pixel in the first place.
 				// Likewise, for very small tags, we don't want the range to be too big.
-				const double range = _cfg->quad_decimate + 1.0;
+				const T range = _refine_range;
 				// How far +/- to look?
 				// Small values compute the gradient more precisely, but are more sensitive to noise.
-				const double grange = _cfg->grange;
+				const T grange = _grange;
 				// Stats for fitting a line.
-				fit_data_t sum;
+				fit_data_t<T> sum;
 				for (uint32_t s = 0; s < nsamples; ++s)
 				{
 					// Compute a point along the line.
 					// Note, we're avoiding sampling *right* at the corners, since those points are the least reliable.
-					const double alpha = (1.0 + s) / (nsamples + 1);
-					const double x0 = pb.x + alpha * (pa.x - pb.x);
-					const double y0 = pb.y + alpha * (pa.y - pb.y);
+					const T alpha = T(1 + s) / T(nsamples + 1);
+					const T x0 = bx + alpha * ax;
+					const T y0 = by + alpha * ay;
 					// Search along the normal to this line, looking at the gradients along the way.
 					// We're looking for a strong response.
 					// Because of the guaranteed winding order of the points in the quad, we will start inside the white portion of the quad and work our way outward.
-					double wn_sum = 0.0;
-					double w_sum = 0.0;
-					for (double n = -range; n <= range; n += 0.25)
+					T wn_sum = T(0);
+					T w_sum = T(0);
+					for (T n = -range; n <= range; n += T(0.25))
 					{
 						// Sample to points (x1,y1) and (x2,y2).
-						int x1 = static_cast<int>(x0 + (n + grange) * nx);
-						int y1 = static_cast<int>(y0 + (n + grange) * ny);
+						int x1 = static_cast<int>(ox + x0 + (n + grange) * nx);
+						int y1 = static_cast<int>(oy + y0 + (n + grange) * ny);
 						if (x1 < 0 || x1 >= w || y1 < 0 || y1 >= h)
 							continue;
-						int x2 = static_cast<int>(x0 + (n - grange) * nx);
-						int y2 = static_cast<int>(y0 + (n - grange) * ny);
+						int x2 = static_cast<int>(ox + x0 + (n - grange) * nx);
+						int y2 = static_cast<int>(oy + y0 + (n - grange) * ny);
 						if (x2 < 0 || x2 >= w || y2 < 0 || y2 >= h)
 							continue;
 						uint8_t g1 = img[y1 * w + x1];
@@ -564,34 +732,37 @@ namespace maytag::_
 						// They can only hurt us.
 						if (g1 < g2)
 							continue;
-						double dg = g1 - g2;
+						T dg = T(g1 - g2);
 						// What shape for weight=f(g2-g1)?
-						double weight = dg * dg;
+						T weight = dg * dg;
 						// Compute weighted average of the gradient at this point.
 						wn_sum += weight * n;
 						w_sum += weight;
 					}
 					// What was the average point along the line?
-					if (w_sum < 0.1)
+					if (w_sum < T(0.1))
 						continue;
-					double n0 = wn_sum / w_sum;
+					T n0 = wn_sum / w_sum;
 					// Where is the point along the line?
-					double bestx = x0 + n0 * nx;
-					double besty = y0 + n0 * ny;
+					T bestx = x0 + n0 * nx;
+					T besty = y0 + n0 * ny;
 					// Update our line fit statistics.
 					sum.wx += bestx;
 					sum.wy += besty;
 					sum.wxx += bestx * bestx;
 					sum.wxy += bestx * besty;
 					sum.wyy += besty * besty;
-					sum.w += 1.0;
+					sum.w += T(1);
 				}
-				if (sum.w < 0.1)
+				if (sum.w < T(0.1))
 					return false;
 				lp[i].calc_point(sum);
 				lp[i].calc_direction();
+				lp[i].px += ox;
+				lp[i].py += oy;
 			}
-			return _calc_corners(lp, quad);
+			T c[8];
+			return _calc_corners(lp, quad, c);
 		}
 
 	public:
@@ -603,28 +774,108 @@ namespace maytag::_
 			const int fsz = std::sqrt(-std::log(cutoff) * 2.0 * sigma * sigma) + 1.0;
 			_filter.resize(2 * fsz + 1);
 			for (int i = -fsz; i <= fsz; ++i)
-				_filter[i + fsz] = std::exp(-i * i / (2.0 * sigma * sigma));
+				_filter[i + fsz] = F(std::exp(-i * i / (2.0 * sigma * sigma)));
+			update_cfg();
+		}
+
+		// Converts the config values to the precision of the math (called when the config is changed, not per frame).
+		void update_cfg()
+		{
+			_quad_decimate = F(_cfg->quad_decimate);
+			_center_eps = F(_cfg->center_eps / _cfg->quad_decimate);
+			_min_tag_size = F(_cfg->min_tag_size);
+			_min_tag_size_2 = F(_cfg->min_tag_size * _cfg->min_tag_size);
+			_min_tag_area = F(_cfg->min_tag_area);
+			_dot_thresh = F(_cfg->dot_thresh);
+			_max_cos = F(_cfg->max_cos);
+			_max_line_fit_mse = F(_cfg->max_line_fit_mse);
+			_refine_range = T(_cfg->quad_decimate + 1.0);
+			_grange = T(_cfg->grange);
 		}
 
 		//
-		const std::vector<quad_t>& calc(std::vector<std::vector<cpt_t>>& contours, const image_t& gray_img)
+		// Quads outside of the mask (if any) are dropped.
+		const std::vector<basic_quad_t<T>>& calc(std::vector<std::vector<cpt_t>>& contours, const image_t& gray_img, const Mask* mask = nullptr)
 		{
 			const uint32_t size = contours.size();
 			_quads.clear();
 			_quads.reserve(size);
+			_time_sort = 0.0;
+			_time_fit = 0.0;
+			_time_refine = 0.0;
+			_perf_sort = perf_t();
+			_perf_fit = perf_t();
+			_perf_refine = perf_t();
+			_stat = quad_stat_t();
+			_stat.contours = size;
+			// The steps of a contour are short, so they are timed only.
+			// The counters are read once for the loop and split between the steps by their time.
+			Stopwatch sw_perf;
+			Stopwatch sw(false);
 			for (uint32_t i = 0; i < size; ++ i)
 			{
-				quad_t quad;
-				if (!_sort_contour(contours[i], quad))
+				basic_quad_t<T> quad;
+				const bool sorted = _sort_contour(contours[i], quad);
+				sw.lap(_time_sort);
+				if (!sorted)
 					continue;
 				_prepare_fit_data(gray_img, contours[i]);
-				if (!_find_quad(quad))
-					continue;
-				if (_cfg->refine_edges && !_refine_edges(gray_img, quad))
+				bool found = _find_quad(quad);
+				if (found && mask && !mask->inside(quad.p))
+				{
+					++_stat.outside;
+					found = false;
+				}
+				sw.lap(_time_fit);
+				if (!found)
 					continue;
+				if (_cfg->refine_edges)
+				{
+					const bool refined = _refine_edges(gray_img, quad);
+					sw.lap(_time_refine);
+					if (!refined)
+					{
+						++_stat.refine;
+						continue;
+					}
+				}
 				_quads.emplace_back(quad);
 			}
+			double time = 0.0;
+			perf_t perf;
+			sw_perf.lap(time, perf);
+			const double time_steps = _time_sort + _time_fit + _time_refine;
+			if (time_steps > 0.0)
+			{
+				_perf_sort = perf.part(_time_sort / time_steps);
+				_perf_refine = perf.part(_time_refine / time_steps);
+				_perf_fit = perf.part(_time_fit / time_steps);
+			}
+			else
+				_perf_fit = perf;
+			_stat.quads = _quads.size();
 			return _quads;
 		}
+
+		const quad_stat_t& stat() const
+		{
+			return _stat;
+		}
+
+		// Bytes held.
+		size_t memory() const
+		{
+			return _filter.capacity() * sizeof(F) + _fit_data.capacity() * sizeof(fit_data_t<F>) + _quads.capacity() * sizeof(basic_quad_t<T>);
+		}
+
+		void timing(timing_t& t, perf_stat_t& p) const
+		{
+			t.quad_sort = _time_sort;
+			t.quad_fit = _time_fit;
+			t.quad_refine = _time_refine;
+			p.quad_sort = _perf_sort;
+			p.quad_fit = _perf_fit;
+			p.quad_refine = _perf_refine;
+		}
 	};
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
+#include <type_traits>
 
 #include "pt.h"
 
@@ -10,10 +11,13 @@ namespace maytag
 	struct tag_t
 	{
 		pt_t p[4];        // Corners.
-		std::string name; // Tag family.
+		uint16_t family;  // Tag family index (see Detector::family).
 		uint16_t id;      // 
 		bool black;       // Tag color (black or white).
 		uint8_t hamming;  // Hamming distance.
 		double score;     //
 	};
+
+	// Results can be copied with memcpy (e.g. into shared memory).
+	static_assert(std::is_trivially_copyable<tag_t>::value, "tag_t must be trivially copyable");
 }
\ No newline at end of file
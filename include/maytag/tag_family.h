@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 
 namespace maytag
@@ -18,5 +20,6 @@ namespace maytag
 		uint8_t h;                 // Minimum hamming distance between any two codes (e.g. 36h11 => 11).
 		bool black = true;         // Tag color (black or white).
 		uint8_t hamming = 0;       // How many errors corrected?
+		std::vector<uint16_t> ids; // Ids of the codes to detect (empty - all codes).
 	};
 }
\ No newline at end of file
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <cstring>
+#include <vector>
 
 #include "cfg.h"
 #include "image.h"
+#include "mask.h"
 
 
 namespace maytag::_
@@ -13,11 +15,14 @@ namespace maytag::_
 	private:
 		const cfg_t* const _cfg;
 		uint32_t _size = 0;
+		uint32_t _ptr_size = 0;
 		uint8_t* _ptr = nullptr;
 		uint8_t* _img_min;
 		uint8_t* _img_max;
 		uint8_t* _img_min_tmp;
 		uint8_t* _img_max_tmp;
+		uint32_t _prev_w = 0;
+		std::vector<uint8_t> _prev_tiles; // Active tiles of the previous masked call (the rest of the image is unknown).
 
 	public:
 		Threshold(const cfg_t* cfg) :
@@ -31,7 +36,8 @@ namespace maytag::_
 				delete[] _ptr;
 		}
 
-		image_t calc(const image_t& gray_img)
+		// Only the active tiles of the mask (if any) are processed.
+		image_t calc(const image_t& gray_img, const Mask* mask = nullptr)
 		{
 			const uint32_t tile_size = _cfg->tile_size;
 			const uint8_t* const img = gray_img.d;
@@ -42,27 +48,50 @@ namespace maytag::_
 			const uint32_t th = h / tile_size;
 			const uint32_t tx_end = tw - 1;
 			const uint32_t ty_end = th - 1;
+			const uint8_t* const tiles = mask ? mask->tiles() : nullptr;
+			const uint8_t* const stat_tiles = mask ? mask->stat_tiles() : nullptr;
+			bool clear = true;
 			if (s > _size)
 			{
+				_prev_tiles.clear();
 				_size = s;
 				if (_ptr)
 					delete[] _ptr;
-				// If tile_size >= 2 then s >= 4 * ts.
 				const uint32_t ts = tw * th;
 				// Memory usage:
-				// |             tresh_img             |
-				// | - img_min_tmp img_max_tmp img_min | img_max |
-				_ptr = new uint8_t[s + ts];
-				_img_max = _ptr + s;
-				_img_min = _img_max - ts;
-				_img_max_tmp = _img_min - ts;
-				_img_min_tmp = _img_max_tmp - ts;
+				// | tresh_img | img_min_tmp | img_max_tmp | img_min | img_max |
+				// The tile statistics are not in the image: with the mask its inactive tiles are kept between frames.
+				_ptr_size = s + 4 * ts;
+				_ptr = new uint8_t[_ptr_size];
+				_img_min_tmp = _ptr + s;
+				_img_max_tmp = _img_min_tmp + ts;
+				_img_min = _img_max_tmp + ts;
+				_img_max = _img_min + ts;
 			}
+			// With the same mask the inactive tiles are still unknown, otherwise the whole image is cleared.
+			if (tiles)
+			{
+				const uint32_t ts = tw * th;
+				clear = (_prev_w != w || _prev_tiles.size() != ts || std::memcmp(_prev_tiles.data(), tiles, ts) != 0);
+				if (clear)
+				{
+					_prev_w = w;
+					_prev_tiles.assign(tiles, tiles + ts);
+				}
+			}
+			else
+				_prev_tiles.clear();
 			// Collect min/max statistics for each tile.
 			for (uint32_t ty = 0, t = 0; ty < th; ++ty)
 			{
 				for (uint32_t tx = 0; tx < tw; ++tx, ++t)
 				{
+					if (stat_tiles && !stat_tiles[t])
+					{
+						_img_min[t] = 255;
+						_img_max[t] = 0;
+						continue;
+					}
 					const uint32_t p = (ty * w + tx) * tile_size;
 					uint8_t min = 255;
 					uint8_t max = 0;
@@ -147,19 +176,29 @@ namespace maytag::_
 				}
 			}
 			// Calculate binary image.
-			std::memset(_ptr, 2, s);
+			if (clear)
+				std::memset(_ptr, 2, s);
 			const uint32_t dy_end_ext = tile_size + h - th * tile_size;
 			const uint32_t dx_end_ext = tile_size + w - tw * tile_size;
 			for (uint32_t ty = 0, t = 0; ty < th; ++ty)
 			{
 				for (uint32_t tx = 0; tx < tw; ++tx, ++t)
 				{
-					const uint8_t thresh = _img_max[t];
-					if (thresh == 0)
+					if (tiles && !tiles[t])
 						continue;
+					const uint8_t thresh = _img_max[t];
 					const uint32_t dy_end = (ty == ty_end) ? dy_end_ext : tile_size;
 					const uint32_t dx_end = (tx == tx_end) ? dx_end_ext : tile_size;
 					const uint32_t p = (ty * w + tx) * tile_size;
+					if (thresh == 0)
+					{
+						if (!clear)
+						{
+							for (uint32_t dy = 0; dy < dy_end; ++dy)
+								std::memset(_ptr + p + dy * w, 2, dx_end);
+						}
+						continue;
+					}
 					for (uint32_t dy = 0; dy < dy_end; ++dy)
 					{
 						for (uint32_t dx = 0, i = p + dy * w; dx < dx_end; ++dx, ++i)
@@ -174,5 +213,11 @@ namespace maytag::_
 			}
 			return image_t(w, h, _ptr);
 		}
+
+		// Bytes held.
+		size_t memory() const
+		{
+			return _ptr_size + _prev_tiles.capacity();
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#if defined(MAYTAG_TIMING)
+#include <chrono>
+#endif
+
+#include "perf.h"
+
+
+namespace maytag
+{
+	// Wall time of the detector stages in the last frame (ms).
+	// Filled only if MAYTAG_TIMING is defined before including maytag, otherwise the timers are compiled out.
+	struct timing_t
+	{
+		double decimate = 0.0;
+		double threshold = 0.0;
+		double contour_label = 0.0;   // Connected contours.
+		double contour_collect = 0.0; // Contour points.
+		double quad_sort = 0.0;       // Sorting of the contour points by angle.
+		double quad_fit = 0.0;        // Line fit and corners.
+		double quad_refine = 0.0;     // Edge refinement.
+		double decode = 0.0;          // Including the dictionary lookup.
+		double dict = 0.0;            // Dictionary lookup (summed over the decode threads).
+
+		double total() const
+		{
+			return decimate + threshold + contour_label + contour_collect + quad_sort + quad_fit + quad_refine + decode;
+		}
+	};
+
+	namespace _
+	{
+		// Adds the time (and the hardware counters) since the previous lap (or the creation) to the stage counters.
+		class Stopwatch
+		{
+		private:
+#if defined(MAYTAG_TIMING)
+			std::chrono::steady_clock::time_point _t;
+#endif
+#if defined(MAYTAG_PERF)
+			perf_t _perf;
+#endif
+
+		public:
+			// perf - the hardware counters are used (a read is a system call, so they are not used for short laps).
+			Stopwatch(bool perf = true)
+			{
+#if defined(MAYTAG_TIMING)
+				_t = std::chrono::steady_clock::now();
+#endif
+#if defined(MAYTAG_PERF)
+				if (perf)
+					PerfGroup::thread().read(_perf);
+#else
+				(void)perf;
+#endif
+			}
+
+			void lap(double& ms)
+			{
+#if defined(MAYTAG_TIMING)
+				const auto t = std::chrono::steady_clock::now();
+				ms += std::chrono::duration<double, std::milli>(t - _t).count();
+				_t = t;
+#else
+				(void)ms;
+#endif
+			}
+
+			void lap(double& ms, perf_t& perf)
+			{
+				lap(ms);
+#if defined(MAYTAG_PERF)
+				perf_t v;
+				if (!PerfGroup::thread().read(v))
+					return;
+				perf.cycles += v.cycles - _perf.cycles;
+				perf.instructions += v.instructions - _perf.instructions;
+				perf.cache_misses += v.cache_misses - _perf.cache_misses;
+				perf.branch_misses += v.branch_misses - _perf.branch_misses;
+				_perf = v;
+#else
+				(void)perf;
+#endif
+			}
+		};
+	}
+}
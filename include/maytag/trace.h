@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#if defined(MAYTAG_TRACE)
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#endif
+
+
+namespace maytag
+{
+	namespace _
+	{
+		// Trace events (Chrome trace event format) in a lock-free ring buffer.
+		// Writers claim a slot with fetch_add, so the newest events overwrite the oldest ones.
+		// Each slot has a sequence number, the reader skips the slots that are being written.
+		class Trace
+		{
+#if defined(MAYTAG_TRACE)
+		private:
+			struct slot_t
+			{
+				std::atomic<uint64_t> seq;  // 2 * (index + 1) when written, odd while writing.
+				std::atomic<uint64_t> name; // const char* (static strings only).
+				std::atomic<uint64_t> ts;   // ns since the start.
+				std::atomic<uint64_t> info; // Thread (16 bits), phase (8 bits) and frame (32 bits).
+			};
+
+			std::unique_ptr<slot_t[]> _slots;
+			uint64_t _mask = 0;
+			std::atomic<uint64_t> _head;
+			std::atomic<bool> _enabled;
+			std::chrono::steady_clock::time_point _t0;
+
+			Trace():
+				_head(0),
+				_enabled(false)
+			{
+			}
+
+			static uint32_t _thread_id()
+			{
+				static std::atomic<uint32_t> next(0);
+				static thread_local uint32_t id = next.fetch_add(1, std::memory_order_relaxed) + 1;
+				return id;
+			}
+
+			static void _write_escaped(FILE* file, const char* str)
+			{
+				for (; *str; ++str)
+				{
+					if (*str == '"' || *str == '\\')
+						std::fputc('\\', file);
+					if (static_cast<unsigned char>(*str) >= 0x20)
+						std::fputc(*str, file);
+				}
+			}
+
+		public:
+			static Trace& instance()
+			{
+				static Trace trace;
+				return trace;
+			}
+
+			// capacity is rounded up to a power of two.
+			// Must not be called while the events are emitted.
+			void start(uint32_t capacity)
+			{
+				uint64_t size = 1;
+				while (size < capacity)
+					size <<= 1;
+				if (size != _mask + 1 || !_slots)
+				{
+					_slots.reset(new slot_t[size]);
+					_mask = size - 1;
+				}
+				for (uint64_t i = 0; i < size; ++i)
+					_slots[i].seq.store(0, std::memory_order_relaxed);
+				_head.store(0, std::memory_order_relaxed);
+				_t0 = std::chrono::steady_clock::now();
+				_enabled.store(true, std::memory_order_release);
+			}
+
+			void stop()
+			{
+				_enabled.store(false, std::memory_order_release);
+			}
+
+			void emit(const char* name, char phase, uint32_t frame)
+			{
+				if (!_enabled.load(std::memory_order_acquire))
+					return;
+				const uint64_t ts = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _t0).count();
+				const uint64_t i = _head.fetch_add(1, std::memory_order_relaxed);
+				slot_t& slot = _slots[i & _mask];
+				slot.seq.store(2 * i + 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				slot.name.store(reinterpret_cast<uintptr_t>(name), std::memory_order_relaxed);
+				slot.ts.store(ts, std::memory_order_relaxed);
+				slot.info.store((static_cast<uint64_t>(_thread_id() & 0xffff) << 40) | (static_cast<uint64_t>(static_cast<uint8_t>(phase)) << 32) | frame,
+					std::memory_order_relaxed);
+				slot.seq.store(2 * (i + 1), std::memory_order_release);
+			}
+
+			// Writes the events in the buffer as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+			// Can be called while the events are emitted (the slots being written are skipped).
+			bool save(const std::string& path) const
+			{
+				if (!_slots)
+					return false;
+				FILE* file = std::fopen(path.c_str(), "w");
+				if (!file)
+					return false;
+				const uint64_t head = _head.load(std::memory_order_acquire);
+				const uint64_t size = _mask + 1;
+				const uint64_t beg = head > size ? head - size : 0;
+				std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+				bool first = true;
+				for (uint64_t i = beg; i < head; ++i)
+				{
+					const slot_t& slot = _slots[i & _mask];
+					const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+					if (seq != 2 * (i + 1))
+						continue;
+					const char* name = reinterpret_cast<const char*>(static_cast<uintptr_t>(slot.name.load(std::memory_order_relaxed)));
+					const uint64_t ts = slot.ts.load(std::memory_order_relaxed);
+					const uint64_t info = slot.info.load(std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (slot.seq.load(std::memory_order_relaxed) != seq)
+						continue;
+					std::fputs(first ? "\n" : ",\n", file);
+					first = false;
+					std::fputs("{\"name\":\"", file);
+					_write_escaped(file, name);
+					std::fprintf(file, "\",\"cat\":\"maytag\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%u}}",
+						static_cast<char>((info >> 32) & 0xff), ts * 1e-3, static_cast<uint32_t>(info >> 40), static_cast<uint32_t>(info));
+				}
+				std::fputs("\n]}\n", file);
+				return std::fclose(file) == 0;
+			}
+#else
+		public:
+			static Trace& instance()
+			{
+				static Trace trace;
+				return trace;
+			}
+
+			void start(uint32_t)
+			{
+			}
+
+			void stop()
+			{
+			}
+
+			void emit(const char*, char, uint32_t)
+			{
+			}
+
+			bool save(const std::string&) const
+			{
+				return false;
+			}
+#endif
+		};
+	}
+
+	// Tracing of the detector stages (begin and end of each stage with the frame number, for each thread).
+	// Available only if MAYTAG_TRACE is defined before including maytag, otherwise the calls are compiled out.
+	// The application can add its own events (e.g. capture), name must be a static string.
+	inline void trace_start(uint32_t capacity = 1 << 16)
+	{
+		_::Trace::instance().start(capacity);
+	}
+
+	inline void trace_stop()
+	{
+		_::Trace::instance().stop();
+	}
+
+	inline void trace_begin(const char* name, uint32_t frame = 0)
+	{
+		_::Trace::instance().emit(name, 'B', frame);
+	}
+
+	inline void trace_end(const char* name, uint32_t frame = 0)
+	{
+		_::Trace::instance().emit(name, 'E', frame);
+	}
+
+	// Chrome trace JSON. Returns false if tracing is not available or the file can not be written.
+	inline bool trace_save(const std::string& path)
+	{
+		return _::Trace::instance().save(path);
+	}
+}
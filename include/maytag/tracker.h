@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "detector.h"
+#include "image.h"
+#include "tag.h"
+
+
+namespace maytag
+{
+	// Detector for video streams where tags move a little between frames.
+	// The tags of the previous frame are expanded into ROIs (regions of interest) and only the ROIs are processed.
+	// The full frame is processed every full_period frames (new tags are found only then)
+	// and when some tracked tag is not found in its ROI (the tag has moved too far or is occluded).
+	// The active area of the detector (set_roi, set_mask) is kept: it is intersected with each ROI.
+	template <typename T>
+	class BasicTracker
+	{
+	private:
+		BasicDetector<T> _detector;
+		std::vector<tag_t> _tags;
+		std::vector<tag_t> _roi_tags;
+		std::vector<roi_t> _rois;
+		std::vector<uint8_t> _crop;
+		std::vector<uint32_t> _keys;
+		std::vector<uint32_t> _prev_keys;
+		// The active area of the detector (set_roi and set_mask, in the input image pixels).
+		// The detector gets it translated into each crop and restored after the crops.
+		std::vector<roi_t> _user_roi;
+		std::vector<uint8_t> _user_mask;
+		uint32_t _user_mask_w = 0;
+		uint32_t _user_mask_h = 0;
+		std::vector<roi_t> _crop_roi;
+		uint32_t _full_period = 10;
+		double _margin = 0.5;       // ROI margin relative to the tag size.
+		uint32_t _min_margin = 8;   // Minimum ROI margin in pixels.
+		uint32_t _frame = 0;        // Frames since the last full scan.
+		bool _full = true;          // The last frame was processed in full.
+
+		static uint32_t _key(const tag_t& tag)
+		{
+			return (static_cast<uint32_t>(tag.family) << 16) | tag.id;
+		}
+
+		// ROIs around the previous tags, overlapping ROIs are merged (a tag must not be found twice).
+		void _make_rois(const image_t& gray_img)
+		{
+			_rois.clear();
+			for (const auto& tag : _tags)
+			{
+				double x0 = tag.p[0].x;
+				double y0 = tag.p[0].y;
+				double x1 = x0;
+				double y1 = y0;
+				for (int i = 1; i < 4; ++i)
+				{
+					x0 = std::min(x0, tag.p[i].x);
+					y0 = std::min(y0, tag.p[i].y);
+					x1 = std::max(x1, tag.p[i].x);
+					y1 = std::max(y1, tag.p[i].y);
+				}
+				const double m = std::max<double>(_min_margin, _margin * std::max(x1 - x0, y1 - y0));
+				roi_t roi;
+				roi.x0 = static_cast<uint32_t>(std::max(0.0, std::floor(x0 - m)));
+				roi.y0 = static_cast<uint32_t>(std::max(0.0, std::floor(y0 - m)));
+				roi.x1 = static_cast<uint32_t>(std::min<double>(gray_img.w, std::ceil(x1 + m)));
+				roi.y1 = static_cast<uint32_t>(std::min<double>(gray_img.h, std::ceil(y1 + m)));
+				if (roi.x0 >= roi.x1 || roi.y0 >= roi.y1)
+					continue;
+				_rois.emplace_back(roi);
+			}
+			// Merging until there are no overlaps (the number of tags is small).
+			bool merged = true;
+			while (merged)
+			{
+				merged = false;
+				for (size_t i = 0; i < _rois.size() && !merged; ++i)
+				{
+					for (size_t j = i + 1; j < _rois.size(); ++j)
+					{
+						roi_t& a = _rois[i];
+						const roi_t& b = _rois[j];
+						if (a.x0 >= b.x1 || b.x0 >= a.x1 || a.y0 >= b.y1 || b.y0 >= a.y1)
+							continue;
+						a.x0 = std::min(a.x0, b.x0);
+						a.y0 = std::min(a.y0, b.y0);
+						a.x1 = std::max(a.x1, b.x1);
+						a.y1 = std::max(a.y1, b.y1);
+						_rois.erase(_rois.begin() + j);
+						merged = true;
+						break;
+					}
+				}
+			}
+		}
+
+		static void _add_crop_roi(std::vector<roi_t>& rois, const roi_t& crop, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+		{
+			x0 = std::max(x0, crop.x0);
+			y0 = std::max(y0, crop.y0);
+			x1 = std::min(x1, crop.x1);
+			y1 = std::min(y1, crop.y1);
+			if (x0 < x1 && y0 < y1)
+				rois.emplace_back(x0 - crop.x0, y0 - crop.y0, x1 - crop.x0, y1 - crop.y0);
+		}
+
+		// The active area of the detector inside the crop (in the crop pixels).
+		// The mask cells are passed as rectangles (the detector treats both as a union of areas).
+		void _make_crop_roi(const image_t& gray_img, const roi_t& crop)
+		{
+			_crop_roi.clear();
+			for (const auto& r : _user_roi)
+				_add_crop_roi(_crop_roi, crop, r.x0, r.y0, r.x1, r.y1);
+			const uint32_t mw = _user_mask_w;
+			const uint32_t mh = _user_mask_h;
+			if (_user_mask.empty() || mw == 0 || mh == 0)
+				return;
+			const uint64_t w = gray_img.w;
+			const uint64_t h = gray_img.h;
+			const uint32_t cx0 = static_cast<uint32_t>(crop.x0 * mw / w);
+			const uint32_t cy0 = static_cast<uint32_t>(crop.y0 * mh / h);
+			const uint32_t cx1 = std::min<uint32_t>(mw, static_cast<uint32_t>((crop.x1 * mw + w - 1) / w));
+			const uint32_t cy1 = std::min<uint32_t>(mh, static_cast<uint32_t>((crop.y1 * mh + h - 1) / h));
+			for (uint32_t cy = cy0; cy < cy1; ++cy)
+			{
+				for (uint32_t cx = cx0; cx < cx1; ++cx)
+				{
+					if (!_user_mask[cy * mw + cx])
+						continue;
+					_add_crop_roi(_crop_roi, crop,
+						static_cast<uint32_t>((cx * w + mw - 1) / mw), static_cast<uint32_t>((cy * h + mh - 1) / mh),
+						static_cast<uint32_t>(((cx + 1) * w + mw - 1) / mw), static_cast<uint32_t>(((cy + 1) * h + mh - 1) / mh));
+				}
+			}
+		}
+
+		// Detection in the ROIs. Returns false if some tracked tag is lost.
+		bool _calc_rois(const image_t& gray_img, std::vector<tag_t>& tags)
+		{
+			_make_rois(gray_img);
+			tags.clear();
+			// The active area of the detector is in the image pixels, it must not be applied to the crops as is.
+			_user_roi = _detector.roi();
+			_user_mask = _detector.mask(_user_mask_w, _user_mask_h);
+			const bool active_area = !_user_roi.empty() || !_user_mask.empty();
+			if (active_area)
+				_detector.set_mask(std::vector<uint8_t>(), 0, 0);
+			for (const auto& roi : _rois)
+			{
+				if (active_area)
+				{
+					_make_crop_roi(gray_img, roi);
+					// Empty ROIs mean the whole crop, so the crops outside the active area are skipped.
+					if (_crop_roi.empty())
+						continue;
+					_detector.set_roi(_crop_roi);
+				}
+				const uint32_t w = roi.x1 - roi.x0;
+				const uint32_t h = roi.y1 - roi.y0;
+				_crop.resize(static_cast<size_t>(w) * h);
+				for (uint32_t y = 0; y < h; ++y)
+					std::memcpy(_crop.data() + y * w, gray_img.d + static_cast<size_t>(roi.y0 + y) * gray_img.w + roi.x0, w);
+				for (auto tag : _detector.calc(image_t(w, h, _crop.data())))
+				{
+					for (int i = 0; i < 4; ++i)
+					{
+						tag.p[i].x += roi.x0;
+						tag.p[i].y += roi.y0;
+					}
+					tags.emplace_back(tag);
+				}
+			}
+			if (active_area)
+			{
+				_detector.set_roi(_user_roi);
+				_detector.set_mask(_user_mask, _user_mask_w, _user_mask_h);
+			}
+			// Each previous tag must be found again (by family and id, the same id can be seen several times).
+			_prev_keys.clear();
+			for (const auto& tag : _tags)
+				_prev_keys.emplace_back(_key(tag));
+			_keys.clear();
+			for (const auto& tag : tags)
+				_keys.emplace_back(_key(tag));
+			std::sort(_prev_keys.begin(), _prev_keys.end());
+			std::sort(_keys.begin(), _keys.end());
+			return std::includes(_keys.begin(), _keys.end(), _prev_keys.begin(), _prev_keys.end());
+		}
+
+	public:
+		BasicDetector<T>& detector()
+		{
+			return _detector;
+		}
+
+		// full_period - the full frame is processed every full_period frames (1 - every frame).
+		// margin - ROI margin relative to the tag size (the maximum expected motion between frames).
+		// min_margin - minimum ROI margin in pixels (the tag border and the white frame around it must be inside).
+		void set_tracking(uint32_t full_period, double margin = 0.5, uint32_t min_margin = 8)
+		{
+			_full_period = full_period < 1 ? 1 : full_period;
+			_margin = margin < 0.0 ? 0.0 : margin;
+			_min_margin = min_margin;
+		}
+
+		// The next frame is processed in full (e.g. after a jump in the video).
+		void reset()
+		{
+			_tags.clear();
+			_frame = 0;
+		}
+
+		// True if the last frame was processed in full.
+		bool full_scan() const
+		{
+			return _full;
+		}
+
+		const std::vector<tag_t>& calc(const image_t& gray_img)
+		{
+			_full = true;
+			if (_frame > 0 && _frame < _full_period && !_tags.empty())
+			{
+				if (_calc_rois(gray_img, _roi_tags))
+				{
+					_tags.swap(_roi_tags);
+					_full = false;
+					++_frame;
+					return _tags;
+				}
+			}
+			_tags = _detector.calc(gray_img);
+			_frame = 1;
+			return _tags;
+		}
+	};
+
+	using Tracker = BasicTracker<double>;
+	using TrackerF = BasicTracker<float>;
+	using TrackerFixed = BasicTracker<fixed_t>;
+}